@@ -12,8 +12,274 @@
 ** This is the implementation of generic hash-tables
 ** used in SQLite.
 */
-#include "sqliteInt.h"
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#if defined(__APPLE__)
+# include <malloc/malloc.h>
+# define HASH_MALLOC_USABLE_SIZE(p) malloc_size(p)
+#elif defined(__GLIBC__)
+# include <malloc.h>
+# define HASH_MALLOC_USABLE_SIZE(p) malloc_usable_size(p)
+#endif
+#include <sys/time.h>
+#include "hash.h"
+
+/* Number of buckets migrated by each insert or delete while the table is
+** being rehashed incrementally.  Defining it as 0 restores the original
+** behavior of rebuilding the whole bucket array in one go.
+*/
+#ifndef HASH_REHASH_STEP
+# define HASH_REHASH_STEP 2
+#endif
+
+/* Largest number of elements in a slab.  Defining it as 0 allocates
+** every element on its own, as the original code did.
+*/
+#ifndef HASH_POOL_SLAB
+# define HASH_POOL_SLAB 1024
+#endif
+
+/* Number of keys sqlite3HashFindBatch() works on at a time: enough for
+** their cache misses to overlap, few enough for the prefetched lines to
+** still be in L1 when they are used.
+*/
+#ifndef HASH_BATCH_GROUP
+# define HASH_BATCH_GROUP 16
+#endif
+#if defined(__GNUC__)
+# define hashPrefetch(p)  __builtin_prefetch(p)
+#else
+# define hashPrefetch(p)
+#endif
+
+/* The hash function.  HASH_FUNC_WYHASH, the default, is wyhash: it
+** reads 8 to 16 bytes per step and mixes them with 64x64->128 bit
+** multiplies.  HASH_FUNC_KNUTH is the original SQLite hash, which
+** reads one byte per step.
+*/
+#define HASH_FUNC_KNUTH   1
+#define HASH_FUNC_WYHASH  2
+#ifndef HASH_FUNC
+# define HASH_FUNC HASH_FUNC_WYHASH
+#endif
+
+typedef unsigned long long u64;
+
+/* Bucket arrays have a power of two size, and a bucket is picked with
+** Fibonacci hashing: the hash times 2**32 divided by the golden ratio,
+** of which the top log2(htsize) bits are kept.  That is one multiply
+** and a shift instead of a division, and the multiply mixes every bit
+** of the hash into the bits kept, whatever the hash function (custom
+** ones included) does with its low bits.  HASH_BUCKET_MODULO restores
+** the original policy: as many buckets as the allocation can hold, and
+** the hash modulo the number of buckets.
+*/
+#ifdef HASH_BUCKET_MODULO
+# define hashBucket(h,n)  ((h) % (n))
+#else
+# define hashBucket(h,n)  (((h)*0x9e3779b1u) >> 1 >> hashClz(n))
+# if defined(__GNUC__)
+#  define hashClz(n)  __builtin_clz(n)
+# else
+static int hashClz(unsigned int n){
+  int i = 0;
+  while( (n & 0x80000000u)==0 ){ n <<= 1; i++; }
+  return i;
+}
+# endif
+#endif
+
+/*
+** The default memory allocator: the C library malloc()/free(), plus the
+** usable size of an allocation where the C library can report it.
+*/
+static void *hashDefaultMalloc(void *pAppData, size_t nByte){
+  (void)pAppData;
+  return malloc(nByte);
+}
+static void hashDefaultFree(void *pAppData, void *p){
+  (void)pAppData;
+  free(p);
+}
+#ifdef HASH_MALLOC_USABLE_SIZE
+static size_t hashDefaultSize(void *pAppData, void *p){
+  (void)pAppData;
+  return HASH_MALLOC_USABLE_SIZE(p);
+}
+#else
+# define hashDefaultSize 0
+#endif
+static const HashMemMethods hashDefaultMem = {
+  hashDefaultMalloc, hashDefaultFree, hashDefaultSize, 0
+};
+
+/* The methods given to new tables by sqlite3HashInit(). */
+static const HashMemMethods *hashMem = &hashDefaultMem;
+
+void sqlite3HashConfigMalloc(const HashMemMethods *pMem){
+  hashMem = pMem ? pMem : &hashDefaultMem;
+}
+
+void sqlite3HashSetMem(Hash *pH, const HashMemMethods *pMem){
+  assert( pH->first==0 && pH->ht==0 && pH->pSlab==0 );
+  pH->pMem = pMem ? pMem : &hashDefaultMem;
+}
+
+#define hashMalloc(H,N) ((H)->pMem->xMalloc((H)->pMem->pAppData, (N)))
+
+/* Pool and arena allocators may not accept NULL, so xFree never sees it.
+*/
+static void hashFree(Hash *pH, void *p){
+  if( p ) pH->pMem->xFree(pH->pMem->pAppData, p);
+}
+
+#ifdef HASH_BUCKET_MODULO
+/* Number of usable bytes of an allocation of nByte bytes at p.
+*/
+static size_t hashMallocSize(const Hash *pH, void *p, size_t nByte){
+  if( pH->pMem->xSize==0 ) return nByte;
+  return pH->pMem->xSize(pH->pMem->pAppData, p);
+}
+#endif
+
+/* A slab of elements.  The first slab of a table holds a few elements,
+** and each new one holds as many as the table does, up to HASH_POOL_SLAB,
+** so a small table stays small and a large one costs one allocation per
+** HASH_POOL_SLAB elements.  Elements are handed out in order from the
+** newest slab, which is not touched before its elements are used, and
+** deleted elements are chained through their next field on Hash.pFree.
+*/
+struct HashSlab {
+  HashSlab *pNext;          /* Next slab of the table */
+  unsigned int nElem;       /* Number of elements in aElem[] */
+  unsigned int nUsed;       /* Elements of aElem[] handed out so far */
+  HashElem aElem[1];        /* The elements.  Really more than one */
+};
+
+#if HASH_POOL_SLAB>0
+/* Add a slab of nElem elements to pH.  The elements the previous slab
+** did not hand out yet go on the free list.  Return 0 if the allocation
+** fails.
+*/
+static int hashSlabAlloc(Hash *pH, unsigned int nElem){
+  HashSlab *pSlab;
+  HashSlab *pOld = pH->pSlab;
+
+  pSlab = (HashSlab*)hashMalloc(pH,
+      offsetof(HashSlab, aElem) + nElem*sizeof(HashElem));
+  if( pSlab==0 ) return 0;
+  while( pOld && pOld->nUsed<pOld->nElem ){
+    HashElem *elem = &pOld->aElem[pOld->nUsed++];
+    elem->next = pH->pFree;
+    pH->pFree = elem;
+  }
+  pSlab->pNext = pOld;
+  pSlab->nElem = nElem;
+  pSlab->nUsed = 0;
+  pH->pSlab = pSlab;
+  return 1;
+}
+#endif
+
+/* Allocate and free a single element of pH.
+*/
+static HashElem *hashElemAlloc(Hash *pH){
+#if HASH_POOL_SLAB>0
+  HashElem *elem = pH->pFree;
+  HashSlab *pSlab = pH->pSlab;
+  if( elem ){
+    pH->pFree = elem->next;
+    return elem;
+  }
+  if( pSlab==0 || pSlab->nUsed==pSlab->nElem ){
+    unsigned int nElem = pH->count;
+    if( nElem<4 ) nElem = 4;
+    if( nElem>HASH_POOL_SLAB ) nElem = HASH_POOL_SLAB;
+    if( !hashSlabAlloc(pH, nElem) ) return 0;
+    pSlab = pH->pSlab;
+  }
+  return &pSlab->aElem[pSlab->nUsed++];
+#else
+  return (HashElem*)hashMalloc(pH, sizeof(HashElem));
+#endif
+}
+static void hashElemFree(Hash *pH, HashElem *elem){
+#if HASH_POOL_SLAB>0
+  elem->next = pH->pFree;
+  pH->pFree = elem;
+#else
+  hashFree(pH, elem);
+#endif
+}
+
+/* An ASCII upper to lower case map, as used by SQLite for case folding.
+*/
+static const unsigned char hashUpperToLower[] = {
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17,
+   18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
+   36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53,
+   54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 97, 98, 99,100,101,102,103,
+  104,105,106,107,108,109,110,111,112,113,114,115,116,117,118,119,120,121,
+  122, 91, 92, 93, 94, 95, 96, 97, 98, 99,100,101,102,103,104,105,106,107,
+  108,109,110,111,112,113,114,115,116,117,118,119,120,121,122,123,124,125,
+  126,127,128,129,130,131,132,133,134,135,136,137,138,139,140,141,142,143,
+  144,145,146,147,148,149,150,151,152,153,154,155,156,157,158,159,160,161,
+  162,163,164,165,166,167,168,169,170,171,172,173,174,175,176,177,178,179,
+  180,181,182,183,184,185,186,187,188,189,190,191,192,193,194,195,196,197,
+  198,199,200,201,202,203,204,205,206,207,208,209,210,211,212,213,214,215,
+  216,217,218,219,220,221,222,223,224,225,226,227,228,229,230,231,232,233,
+  234,235,236,237,238,239,240,241,242,243,244,245,246,247,248,249,250,251,
+  252,253,254,255
+};
+
+/* Read 8 bytes, in the byte order of the machine.
+*/
+static u64 hashRead8(const unsigned char *p){
+  u64 v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+/* Fold the ASCII upper case letters of the 8 bytes of w to lower case,
+** as hashUpperToLower[] does one byte at a time.  For each byte below
+** 0x80, adding 0x3f sets its high bit if it is 'A' or more and adding
+** 0x25 if it is more than 'Z'; the difference of the two is the 0x20
+** bit to add to upper case letters.  Bytes of 0x80 and more are left
+** alone, and no addition carries into the next byte.
+*/
+#define HASH_LSB 0x0101010101010101ULL
+#define HASH_MSB 0x8080808080808080ULL
+static u64 hashFold8(u64 w){
+  u64 low = w & ~HASH_MSB;
+  u64 upper = ((low + 0x3f*HASH_LSB) ^ (low + 0x25*HASH_LSB)) & ~w & HASH_MSB;
+  return w | (upper>>2);
+}
+
+/* Case insensitive comparison of the first N bytes of two strings, in
+** the same way as sqlite3StrNICmp() but without stopping at a NUL byte.
+** Equal runs are skipped 8 bytes at a time.
+*/
+static int hashStrNICmp(const char *zLeft, const char *zRight, int N){
+  const unsigned char *a, *b;
+  a = (const unsigned char *)zLeft;
+  b = (const unsigned char *)zRight;
+  while( N>=8 ){
+    u64 x = hashRead8(a), y = hashRead8(b);
+    if( x!=y && hashFold8(x)!=hashFold8(y) ) break;
+    a += 8;
+    b += 8;
+    N -= 8;
+  }
+  while( N-- > 0 ){
+    if( *a!=*b && hashUpperToLower[*a]!=hashUpperToLower[*b] ){
+      return (int)hashUpperToLower[*a] - (int)hashUpperToLower[*b];
+    }
+    a++;
+    b++;
+  }
+  return 0;
+}
 
 /* Turn bulk memory into a hash table object by initializing the
 ** fields of the Hash structure.
@@ -26,6 +292,34 @@ void sqlite3HashInit(Hash *pNew){
   pNew->count = 0;
   pNew->htsize = 0;
   pNew->ht = 0;
+  pNew->htsizeNew = 0;
+  pNew->iRehash = 0;
+  pNew->htNew = 0;
+  pNew->pMem = hashMem;
+  pNew->keyClass = SQLITE_HASH_STRING;
+  pNew->pKeyMethods = 0;
+  pNew->pSlab = 0;
+  pNew->pFree = 0;
+}
+
+/* Set the key class of an empty table.
+*/
+void sqlite3HashSetKeyClass(Hash *pH, int keyClass){
+  assert( pH->first==0 );
+  assert( keyClass==SQLITE_HASH_STRING || keyClass==SQLITE_HASH_BINARY );
+  pH->keyClass = (unsigned char)keyClass;
+  pH->pKeyMethods = 0;
+}
+
+/* Make an empty table use keys of the SQLITE_HASH_CUSTOM class, hashed
+** and compared by pMethods.  The structure is not copied and must stay
+** valid as long as the table uses it.
+*/
+void sqlite3HashSetKeyMethods(Hash *pH, const HashKeyMethods *pMethods){
+  assert( pH->first==0 );
+  assert( pMethods!=0 && pMethods->xHash!=0 && pMethods->xCompare!=0 );
+  pH->keyClass = SQLITE_HASH_CUSTOM;
+  pH->pKeyMethods = pMethods;
 }
 
 /* Remove all entries from a hash table.  Reclaim all memory.
@@ -34,36 +328,170 @@ void sqlite3HashInit(Hash *pNew){
 */
 void sqlite3HashClear(Hash *pH){
   HashElem *elem;         /* For looping over all elements of the table */
+  HashSlab *pSlab;        /* For looping over the slabs of the table */
 
   assert( pH!=0 );
   elem = pH->first;
   pH->first = 0;
-  sqlite3_free(pH->ht);
+  hashFree(pH, pH->ht);
   pH->ht = 0;
   pH->htsize = 0;
-  while( elem ){
-    HashElem *next_elem = elem->next;
-    sqlite3_free(elem);
-    elem = next_elem;
+  hashFree(pH, pH->htNew);
+  pH->htNew = 0;
+  pH->htsizeNew = 0;
+  pH->iRehash = 0;
+  if( HASH_POOL_SLAB==0 ){
+    while( elem ){
+      HashElem *next_elem = elem->next;
+      hashFree(pH, elem);
+      elem = next_elem;
+    }
+  }
+  pSlab = pH->pSlab;
+  pH->pSlab = 0;
+  pH->pFree = 0;
+  while( pSlab ){
+    HashSlab *pNext = pSlab->pNext;
+    hashFree(pH, pSlab);
+    pSlab = pNext;
   }
   pH->count = 0;
 }
 
+#if HASH_FUNC==HASH_FUNC_KNUTH
 /*
-** The hashing function.
+** The hashing function.  String keys are folded to lower case.
 */
-static unsigned int strHash(const char *z){
+static unsigned int knuthHash(const char *z, int nKey, int bFold){
   unsigned int h = 0;
-  unsigned char c;
-  while( (c = (unsigned char)*z++)!=0 ){     /*OPTIMIZATION-IF-TRUE*/
+  while( nKey-- > 0 ){
     /* Knuth multiplicative hashing.  (Sorting & Searching, p. 510).
     ** 0x9e3779b1 is 2654435761 which is the closest prime number to
     ** (2**32)*golden_ratio, where golden_ratio = (sqrt(5) - 1)/2. */
-    h += sqlite3UpperToLower[c];
+    unsigned char c = (unsigned char)*z++;
+    h += bFold ? hashUpperToLower[c] : c;
     h *= 0x9e3779b1;
   }
   return h;
 }
+#define strHash(Z,N)  knuthHash(Z,N,1)
+#define binHash(Z,N)  knuthHash(Z,N,0)
+
+#else /* HASH_FUNC==HASH_FUNC_WYHASH */
+/*
+** wyhash by Wang Yi (public domain), with the default seed and secret.
+** String keys are folded to lower case as they are read: since folding
+** works on each byte alone, folding the words read gives the same hash
+** as folding the key first, including for the overlapping reads of
+** short keys and of the tail.
+*/
+static const u64 wySecret[4] = {
+  0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+  0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+};
+
+/* The 128 bit product of *pA and *pB, low half in *pA, high in *pB.
+*/
+static void wyMum(u64 *pA, u64 *pB){
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = *pA;
+  r *= *pB;
+  *pA = (u64)r;
+  *pB = (u64)(r>>64);
+#else
+  u64 ha = *pA>>32, hb = *pB>>32, la = (unsigned int)*pA, lb = (unsigned int)*pB;
+  u64 rh = ha*hb, rm0 = ha*lb, rm1 = hb*la, rl = la*lb, t = rl+(rm0<<32);
+  u64 c = t<rl, lo;
+  lo = t+(rm1<<32);
+  c += lo<t;
+  *pA = lo;
+  *pB = rh+(rm0>>32)+(rm1>>32)+c;
+#endif
+}
+static u64 wyMix(u64 a, u64 b){
+  wyMum(&a, &b);
+  return a^b;
+}
+
+static u64 hashRead4(const unsigned char *p){
+  unsigned int v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+#define wyRead8(P)  (bFold ? hashFold8(hashRead8(P)) : hashRead8(P))
+#define wyRead4(P)  (bFold ? hashFold8(hashRead4(P)) : hashRead4(P))
+#define wyByte(P)   ((u64)(bFold ? hashUpperToLower[*(P)] : *(P)))
+
+static unsigned int wyHash(const char *zKey, int nKey, int bFold){
+  const unsigned char *p = (const unsigned char *)zKey;
+  size_t len = (size_t)nKey, i = len;
+  u64 seed = wyMix(wySecret[0], wySecret[1]);
+  u64 a, b;
+  if( len<=16 ){
+    if( len>=4 ){
+      a = (wyRead4(p)<<32) | wyRead4(p+((len>>3)<<2));
+      b = (wyRead4(p+len-4)<<32) | wyRead4(p+len-4-((len>>3)<<2));
+    }else if( len>0 ){
+      a = (wyByte(p)<<16) | (wyByte(p+(len>>1))<<8) | wyByte(p+len-1);
+      b = 0;
+    }else{
+      a = b = 0;
+    }
+  }else{
+    if( i>48 ){
+      u64 see1 = seed, see2 = seed;
+      do{
+        seed = wyMix(wyRead8(p)^wySecret[1], wyRead8(p+8)^seed);
+        see1 = wyMix(wyRead8(p+16)^wySecret[2], wyRead8(p+24)^see1);
+        see2 = wyMix(wyRead8(p+32)^wySecret[3], wyRead8(p+40)^see2);
+        p += 48;
+        i -= 48;
+      }while( i>48 );
+      seed ^= see1^see2;
+    }
+    while( i>16 ){
+      seed = wyMix(wyRead8(p)^wySecret[1], wyRead8(p+8)^seed);
+      p += 16;
+      i -= 16;
+    }
+    a = wyRead8(p+i-16);
+    b = wyRead8(p+i-8);
+  }
+  a ^= wySecret[1];
+  b ^= seed;
+  wyMum(&a, &b);
+  return (unsigned int)wyMix(a^wySecret[0]^len, b^wySecret[1]);
+}
+#define strHash(Z,N)  wyHash(Z,N,1)
+#define binHash(Z,N)  wyHash(Z,N,0)
+#endif /* HASH_FUNC */
+
+/* Hash a key of the key class of pH.
+*/
+static unsigned int keyHash(const Hash *pH, const char *pKey, int nKey){
+  switch( pH->keyClass ){
+    case SQLITE_HASH_BINARY:
+      return binHash(pKey, nKey);
+    case SQLITE_HASH_CUSTOM:
+      return pH->pKeyMethods->xHash(pH->pKeyMethods->pAppData, pKey, nKey);
+    default:
+      return strHash(pKey, nKey);
+  }
+}
+
+/* Walk the count elements from elem on, leaving elem at the first one
+** with hash h for which MATCH is true, or at NULL.  There is one copy
+** of the loop for each key class, so that the key comparison of the
+** class is inlined instead of being chosen for each element.
+*/
+#define hashScan(elem, count, h, MATCH)                 \
+  while( count-- ){                                     \
+    assert( elem!=0 );                                  \
+    if( elem->h==h && (MATCH) ) break;                  \
+    elem = elem->next;                                  \
+  }                                                     \
+  if( count<0 ) elem = 0
 
 
 /* Link pNew element into the hash table pH.  If pEntry!=0 then also
@@ -97,111 +525,297 @@ static void insertElement(
 }
 
 
-/* Resize the hash table so that it cantains "new_size" buckets.
-**
-** The hash table might fail to resize if sqlite3_malloc() fails or
-** if the new size is the same as the prior size.
-** Return TRUE if the resize occurs and false if not.
+/* Unlink elem from the global list of elements, leaving the buckets
+** alone.
 */
-static int rehash(Hash *pH, unsigned int new_size){
-  struct _ht *new_ht;            /* The new hash table */
-  HashElem *elem, *next_elem;    /* For looping over existing elements */
+static void unlinkElement(Hash *pH, HashElem *elem){
+  if( elem->prev ){
+    elem->prev->next = elem->next; 
+  }else{
+    pH->first = elem->next;
+  }
+  if( elem->next ){
+    elem->next->prev = elem->prev;
+  }
+}
 
+/* Allocate a zeroed array of about *pnSize buckets and store in
+** *pnSize the number of buckets actually available.  Return NULL if
+** the allocation fails.
+*/
+static struct _ht *allocBuckets(Hash *pH, unsigned int *pnSize){
+  struct _ht *new_ht;
+  unsigned int new_size = *pnSize;
+
+#ifndef HASH_BUCKET_MODULO
+  /* The largest power of two not above the request, so that the array
+  ** grows four times over when count passes 2*htsize, as it does with
+  ** the original sizing policy. */
+  new_size = 1;
+  while( new_size<=*pnSize/2 ) new_size <<= 1;
+#endif
 #if SQLITE_MALLOC_SOFT_LIMIT>0
   if( new_size*sizeof(struct _ht)>SQLITE_MALLOC_SOFT_LIMIT ){
+# ifdef HASH_BUCKET_MODULO
     new_size = SQLITE_MALLOC_SOFT_LIMIT/sizeof(struct _ht);
+# else
+    while( new_size*sizeof(struct _ht)>SQLITE_MALLOC_SOFT_LIMIT ){
+      new_size >>= 1;
+    }
+# endif
   }
-  if( new_size==pH->htsize ) return 0;
 #endif
 
-  /* The inability to allocates space for a larger hash table is
-  ** a performance hit but it is not a fatal error.  So mark the
-  ** allocation as a benign. Use sqlite3Malloc()/memset(0) instead of 
-  ** sqlite3MallocZero() to make the allocation, as sqlite3MallocZero()
-  ** only zeroes the requested number of bytes whereas this module will
-  ** use the actual amount of space allocated for the hash table (which
-  ** may be larger than the requested amount).
+  new_ht = (struct _ht *)hashMalloc(pH, new_size*sizeof(struct _ht));
+  if( new_ht==0 ) return 0;
+#ifdef HASH_BUCKET_MODULO
+  /* Use memset(0) on the usable size rather than zeroing the requested
+  ** bytes only, as this module will use the actual amount of space
+  ** allocated for the hash table (which may be larger than the requested
+  ** amount).
   */
-  sqlite3BeginBenignMalloc();
-  new_ht = (struct _ht *)sqlite3Malloc( new_size*sizeof(struct _ht) );
-  sqlite3EndBenignMalloc();
+  new_size = (unsigned int)(
+      hashMallocSize(pH, new_ht, new_size*sizeof(struct _ht))/sizeof(struct _ht));
+#endif
+  memset(new_ht, 0, new_size*sizeof(struct _ht));
+  *pnSize = new_size;
+  return new_ht;
+}
+
+/* Make new_ht, an array of new_size empty buckets, the bucket array of
+** pH and put every element of the global list in it.  The previous
+** array must have been freed by the caller.
+*/
+static void rebuildBuckets(
+  Hash *pH,              /* The hash table */
+  struct _ht *new_ht,    /* The new bucket array */
+  unsigned int new_size  /* Number of buckets in new_ht */
+){
+  HashElem *elem, *next_elem;    /* For looping over existing elements */
 
-  if( new_ht==0 ) return 0;
-  sqlite3_free(pH->ht);
   pH->ht = new_ht;
-  pH->htsize = new_size = sqlite3MallocSize(new_ht)/sizeof(struct _ht);
-  memset(new_ht, 0, new_size*sizeof(struct _ht));
+  pH->htsize = new_size;
   for(elem=pH->first, pH->first=0; elem; elem = next_elem){
-    unsigned int h = strHash(elem->pKey) % new_size;
+    unsigned int h = hashBucket(elem->h, new_size);
     next_elem = elem->next;
     insertElement(pH, &new_ht[h], elem);
   }
+}
+
+/* Resize the hash table so that it cantains "new_size" buckets, moving
+** every element at once.  This is used when the table gets its first
+** bucket array, which happens while it is still small.
+**
+** The hash table might fail to resize if the allocation fails or
+** if the new size is the same as the prior size.
+** Return TRUE if the resize occurs and false if not.
+*/
+static int rehash(Hash *pH, unsigned int new_size){
+  struct _ht *new_ht;            /* The new hash table */
+
+  assert( pH->htNew==0 );
+  /* The inability to allocates space for a larger hash table is
+  ** a performance hit but it is not a fatal error. */
+  new_ht = allocBuckets(pH, &new_size);
+  if( new_ht==0 ) return 0;
+  if( new_size==pH->htsize ){
+    hashFree(pH, new_ht);
+    return 0;
+  }
+  hashFree(pH, pH->ht);
+  rebuildBuckets(pH, new_ht, new_size);
   return 1;
 }
 
+/* Start an incremental rehash toward a bucket array of "new_size"
+** buckets.  Until it is complete, the buckets of the old array before
+** Hash.iRehash are empty and their elements live in Hash.htNew, while
+** the other buckets are still used as they are.  Every element stays on
+** the global list, so iteration is not affected.
+**
+** Return TRUE if the rehash was started and false if not.
+*/
+static int rehashStart(Hash *pH, unsigned int new_size){
+  struct _ht *new_ht;
+
+  assert( pH->ht!=0 && pH->htNew==0 );
+  new_ht = allocBuckets(pH, &new_size);
+  if( new_ht==0 ) return 0;
+  if( new_size==pH->htsize ){
+    hashFree(pH, new_ht);
+    return 0;
+  }
+  pH->htNew = new_ht;
+  pH->htsizeNew = new_size;
+  pH->iRehash = 0;
+  return 1;
+}
+
+/* Move the elements of up to nBucket buckets of an incremental rehash
+** to the new bucket array, and switch to the new array once every bucket
+** has moved.  The elements of a bucket are contiguous on the global list
+** and, once moved, they are linked next to the other elements of their
+** new bucket, so no bucket of either array is ever split.
+**
+** Return TRUE if the rehash is still in progress.
+*/
+static int rehashStep(Hash *pH, unsigned int nBucket){
+  if( pH->htNew==0 ) return 0;
+  while( nBucket-- && pH->iRehash<pH->htsize ){
+    struct _ht *pOld = &pH->ht[pH->iRehash++];
+    HashElem *elem = pOld->chain;
+    HashElem *next_elem;
+    int count = pOld->count;
+    while( count-- ){
+      unsigned int h = hashBucket(elem->h, pH->htsizeNew);
+      next_elem = elem->next;
+      unlinkElement(pH, elem);
+      insertElement(pH, &pH->htNew[h], elem);
+      elem = next_elem;
+    }
+    pOld->chain = 0;
+    pOld->count = 0;
+  }
+  if( pH->iRehash<pH->htsize ) return 1;
+  hashFree(pH, pH->ht);
+  pH->ht = pH->htNew;
+  pH->htsize = pH->htsizeNew;
+  pH->htNew = 0;
+  pH->htsizeNew = 0;
+  pH->iRehash = 0;
+  return 0;
+}
+
+/* Number of buckets of Hash.ht moved by each insert or delete.  When
+** the table shrinks, the old buckets are mostly empty: as many of them
+** are moved as map to HASH_REHASH_STEP buckets of the new array, so
+** that each step moves about as many elements as when growing and the
+** shrink completes before the table can shrink again.
+*/
+static unsigned int rehashBudget(const Hash *pH){
+  if( pH->htNew && pH->htsizeNew<pH->htsize ){
+    return HASH_REHASH_STEP*(pH->htsize/pH->htsizeNew);
+  }
+  return HASH_REHASH_STEP;
+}
+
+/* Start shrinking the bucket array of pH if it is less than 1/8 full.
+** The table grows when it holds twice as many elements as buckets and
+** both land at 2 buckets per element rounded down to a power of two,
+** so a table has to lose most of its elements after a resize before it
+** shrinks, and to double before it grows again.
+*/
+static void shrinkIfSparse(Hash *pH){
+  if( pH->htsize>=64 && pH->count<pH->htsize/8 && pH->htNew==0 ){
+    if( HASH_REHASH_STEP==0 ){
+      rehash(pH, pH->count*2);
+    }else{
+      rehashStart(pH, pH->count*2);
+    }
+  }
+}
+
+/* Return the bucket holding the elements with hash h, or NULL if the
+** table has no bucket array yet.  While rehashing, buckets of the old
+** array that were already moved are looked up in the new one.
+*/
+static struct _ht *findBucket(const Hash *pH, unsigned int h){
+  unsigned int i;
+  if( pH->ht==0 ) return 0;
+  i = hashBucket(h, pH->htsize);
+  if( pH->htNew && i<pH->iRehash ){
+    return &pH->htNew[hashBucket(h, pH->htsizeNew)];
+  }
+  return &pH->ht[i];
+}
+
+/* Return the first of the count elements from elem on whose key matches
+** pKey,nKey, of hash h, or NULL if there is none.  Every element caches
+** the full hash of its key, so the keys are only compared when the
+** hashes match.
+*/
+static HashElem *scanChain(
+  const Hash *pH,     /* The pH to be searched */
+  HashElem *elem,     /* First element to test */
+  int count,          /* Number of elements to test */
+  const char *pKey,   /* The key we are searching for */
+  int nKey,           /* Bytes in the key */
+  unsigned int h      /* The full hash of pKey */
+){
+  switch( pH->keyClass ){
+    case SQLITE_HASH_BINARY: {
+      hashScan(elem, count, h,
+               elem->nKey==nKey && memcmp(elem->pKey,pKey,nKey)==0);
+      break;
+    }
+    case SQLITE_HASH_CUSTOM: {
+      const HashKeyMethods *pM = pH->pKeyMethods;
+      hashScan(elem, count, h,
+               pM->xCompare(pM->pAppData,elem->pKey,elem->nKey,pKey,nKey)==0);
+      break;
+    }
+    default: {
+      hashScan(elem, count, h,
+               elem->nKey==nKey && hashStrNICmp(elem->pKey,pKey,nKey)==0);
+      break;
+    }
+  }
+  return elem;
+}
+
 /* This function (for internal use only) locates an element in an
 ** hash table that matches the given key.  If no element is found,
 ** a pointer to a static null element with HashElem.data==0 is returned.
-** If pH is not NULL, then the hash for this key is written to *pH.
+** If ppEntry is not NULL, then the bucket for this key (NULL if the
+** table has no bucket array) is written to *ppEntry, and if pHash is
+** not NULL the full hash of the key is written to *pHash.
 */
 static HashElem *findElementWithHash(
   const Hash *pH,     /* The pH to be searched */
   const char *pKey,   /* The key we are searching for */
+  int nKey,           /* Bytes in the key */
+  struct _ht **ppEntry, /* Write the bucket here */
   unsigned int *pHash /* Write the hash value here */
 ){
   HashElem *elem;                /* Used to loop thru the element list */
   int count;                     /* Number of elements left to test */
-  unsigned int h;                /* The computed hash */
-  static HashElem nullElement = { 0, 0, 0, 0 };
+  struct _ht *pEntry;            /* The bucket for this key */
+  unsigned int h;                /* The full hash of pKey */
+  static HashElem nullElement = { 0, 0, 0, 0, 0, 0 };
 
+  h = keyHash(pH, pKey, nKey);
+  if( pHash ) *pHash = h;
   if( pH->ht ){   /*OPTIMIZATION-IF-TRUE*/
-    struct _ht *pEntry;
-    h = strHash(pKey) % pH->htsize;
-    pEntry = &pH->ht[h];
+    pEntry = findBucket(pH, h);
     elem = pEntry->chain;
     count = pEntry->count;
   }else{
-    h = 0;
+    pEntry = 0;
     elem = pH->first;
     count = pH->count;
   }
-  if( pHash ) *pHash = h;
-  while( count-- ){
-    assert( elem!=0 );
-    if( sqlite3StrICmp(elem->pKey,pKey)==0 ){ 
-      return elem;
-    }
-    elem = elem->next;
-  }
-  return &nullElement;
+  if( ppEntry ) *ppEntry = pEntry;
+  elem = scanChain(pH, elem, count, pKey, nKey, h);
+  return elem ? elem : &nullElement;
 }
 
 /* Remove a single entry from the hash table given a pointer to that
-** element and a hash on the element's key.
+** element and the bucket holding it.
 */
 static void removeElementGivenHash(
   Hash *pH,         /* The pH containing "elem" */
   HashElem* elem,   /* The element to be removed from the pH */
-  unsigned int h    /* Hash value for the element */
+  struct _ht *pEntry /* The bucket of the element, or NULL */
 ){
-  struct _ht *pEntry;
-  if( elem->prev ){
-    elem->prev->next = elem->next; 
-  }else{
-    pH->first = elem->next;
-  }
-  if( elem->next ){
-    elem->next->prev = elem->prev;
-  }
-  if( pH->ht ){
-    pEntry = &pH->ht[h];
+  unlinkElement(pH, elem);
+  if( pEntry ){
     if( pEntry->chain==elem ){
       pEntry->chain = elem->next;
     }
     pEntry->count--;
     assert( pEntry->count>=0 );
   }
-  sqlite3_free( elem );
+  hashElemFree(pH, elem);
   pH->count--;
   if( pH->count==0 ){
     assert( pH->first==0 );
@@ -211,16 +825,83 @@ static void removeElementGivenHash(
 }
 
 /* Attempt to locate an element of the hash table pH with a key
-** that matches pKey.  Return the data for this element if it is
+** that matches pKey,nKey.  Return the data for this element if it is
 ** found, or NULL if there is no match.
 */
+void *sqlite3HashFindKey(const Hash *pH, const void *pKey, int nKey){
+  assert( pH!=0 );
+  assert( pKey!=0 );
+  assert( nKey>=0 );
+  return findElementWithHash(pH, (const char *)pKey, nKey, 0, 0)->data;
+}
 void *sqlite3HashFind(const Hash *pH, const char *pKey){
+  assert( pKey!=0 );
+  return sqlite3HashFindKey(pH, pKey, (int)strlen(pKey));
+}
+
+/* Look up the n keys azKey[], of anKey[] bytes or NUL terminated if
+** anKey is NULL, and write their data to aData[].  The keys go through
+** the table HASH_BATCH_GROUP at a time, in stages: every key of the
+** group is hashed and its bucket prefetched, then every bucket is read
+** and its first element prefetched, then the key of that element, and
+** only then are the chains scanned.  The misses of the group overlap
+** instead of being taken one after the other.
+*/
+void sqlite3HashFindBatch(
+  const Hash *pH,             /* The table to search */
+  const char *const *azKey,   /* The keys */
+  const int *anKey,           /* Their lengths, or NULL */
+  int n,                      /* Number of keys */
+  void **aData                /* OUT: the data of each key, or NULL */
+){
+  unsigned int aH[HASH_BATCH_GROUP];       /* Hash of each key */
+  int aN[HASH_BATCH_GROUP];                /* Bytes in each key */
+  struct _ht *aEntry[HASH_BATCH_GROUP];    /* Bucket of each key */
+  int i, j, nGroup;
+
+  assert( pH!=0 );
+  assert( n>=0 );
+  if( pH->ht==0 ){
+    for(i=0; i<n; i++){
+      int nKey = anKey ? anKey[i] : (int)strlen(azKey[i]);
+      aData[i] = sqlite3HashFindKey(pH, azKey[i], nKey);
+    }
+    return;
+  }
+  for(i=0; i<n; i+=nGroup){
+    nGroup = n-i<HASH_BATCH_GROUP ? n-i : HASH_BATCH_GROUP;
+    for(j=0; j<nGroup; j++){
+      aN[j] = anKey ? anKey[i+j] : (int)strlen(azKey[i+j]);
+      aH[j] = keyHash(pH, azKey[i+j], aN[j]);
+      aEntry[j] = findBucket(pH, aH[j]);
+      hashPrefetch(aEntry[j]);
+    }
+    for(j=0; j<nGroup; j++){
+      if( aEntry[j]->count ) hashPrefetch(aEntry[j]->chain);
+    }
+    for(j=0; j<nGroup; j++){
+      if( aEntry[j]->count && aEntry[j]->chain->h==aH[j] ){
+        hashPrefetch(aEntry[j]->chain->pKey);
+      }
+    }
+    for(j=0; j<nGroup; j++){
+      HashElem *elem = scanChain(pH, aEntry[j]->chain, aEntry[j]->count,
+                                 azKey[i+j], aN[j], aH[j]);
+      aData[i+j] = elem ? elem->data : 0;
+    }
+  }
+}
+
+/* Return the hash of the key pKey,nKey, as computed by pH.
+*/
+unsigned int sqlite3HashKeyHash(const Hash *pH, const void *pKey, int nKey){
   assert( pH!=0 );
   assert( pKey!=0 );
-  return findElementWithHash(pH, pKey, 0)->data;
+  assert( nKey>=0 );
+  return keyHash(pH, (const char *)pKey, nKey);
 }
 
-/* Insert an element into the hash table pH.  The key is pKey
+/* Insert an element into the hash table pH.  The key is pKey,nKey
 ** and the data is "data".
 **
 ** If no element exists with a matching key, then a new
@@ -234,36 +915,166 @@ void *sqlite3HashFind(const Hash *pH, const char *pKey){
 ** If the "data" parameter to this function is NULL, then the
 ** element corresponding to "key" is removed from the hash table.
 */
-void *sqlite3HashInsert(Hash *pH, const char *pKey, void *data){
-  unsigned int h;       /* the hash of the key modulo hash table size */
+void *sqlite3HashInsertKey(Hash *pH, const void *pKey, int nKey, void *data){
+  struct _ht *pEntry;   /* the bucket of the key */
   HashElem *elem;       /* Used to loop thru the element list */
   HashElem *new_elem;   /* New element added to the pH */
+  unsigned int h;       /* the full hash of the key */
 
   assert( pH!=0 );
   assert( pKey!=0 );
-  elem = findElementWithHash(pH,pKey,&h);
+  assert( nKey>=0 );
+  rehashStep(pH, rehashBudget(pH));
+  elem = findElementWithHash(pH,(const char *)pKey,nKey,&pEntry,&h);
   if( elem->data ){
     void *old_data = elem->data;
     if( data==0 ){
-      removeElementGivenHash(pH,elem,h);
+      removeElementGivenHash(pH,elem,pEntry);
+      shrinkIfSparse(pH);
     }else{
+      /* Custom keys may compare equal with different lengths */
       elem->data = data;
-      elem->pKey = pKey;
+      elem->pKey = (const char *)pKey;
+      elem->nKey = nKey;
     }
     return old_data;
   }
   if( data==0 ) return 0;
-  new_elem = (HashElem*)sqlite3Malloc( sizeof(HashElem) );
+  new_elem = hashElemAlloc(pH);
   if( new_elem==0 ) return data;
-  new_elem->pKey = pKey;
+  new_elem->pKey = (const char *)pKey;
+  new_elem->nKey = nKey;
   new_elem->data = data;
+  new_elem->h = h;
   pH->count++;
-  if( pH->count>=10 && pH->count > 2*pH->htsize ){
-    if( rehash(pH, pH->count*2) ){
-      assert( pH->htsize>0 );
-      h = strHash(pKey) % pH->htsize;
+  if( pH->count>=10 && pH->count > 2*pH->htsize && pH->htNew==0 ){
+    if( pH->ht==0 || HASH_REHASH_STEP==0 ){
+      if( rehash(pH, pH->count*2) ){
+        assert( pH->htsize>0 );
+        pEntry = findBucket(pH, h);
+      }
+    }else{
+      rehashStart(pH, pH->count*2);
     }
   }
-  insertElement(pH, pH->ht ? &pH->ht[h] : 0, new_elem);
+  insertElement(pH, pEntry, new_elem);
+  return 0;
+}
+void *sqlite3HashInsert(Hash *pH, const char *pKey, void *data){
+  assert( pKey!=0 );
+  return sqlite3HashInsertKey(pH, pKey, (int)strlen(pKey), data);
+}
+
+/* Make room in pH for nEntry entries: a bucket array as large as the
+** table would have grown to by then, and elements for the entries not
+** in the table yet.  Return 0 if memory could not be allocated.
+*/
+int sqlite3HashReserve(Hash *pH, unsigned int nEntry){
+  assert( pH!=0 );
+  if( nEntry>=10 && nEntry/2>pH->htsize ){
+    /* Finish a rehash in progress, then rebuild at the final size */
+    rehashStep(pH, pH->htsize);
+    if( nEntry/2>pH->htsize
+     && !rehash(pH, nEntry<=0x7fffffff ? nEntry*2 : nEntry) ){
+      return 0;
+    }
+  }
+#if HASH_POOL_SLAB>0
+  if( nEntry>pH->count ){
+    HashSlab *pSlab = pH->pSlab;
+    unsigned int nNeed = nEntry - pH->count;
+    unsigned int nLeft = pSlab ? pSlab->nElem - pSlab->nUsed : 0;
+    if( nNeed>nLeft && !hashSlabAlloc(pH, nNeed - nLeft) ) return 0;
+  }
+#endif
+  return 1;
+}
+
+/* Initialize pNew with room for nEntry entries.
+*/
+int sqlite3HashInitSize(Hash *pNew, unsigned int nEntry){
+  sqlite3HashInit(pNew);
+  return sqlite3HashReserve(pNew, nEntry);
+}
+
+/* Shrink pH to fit its entries: the bucket array is rebuilt at the size
+** the table would have grown to, and the elements are copied to a single
+** slab, releasing the slabs and free elements left by deletes.  Return
+** 0 if memory could not be allocated, in which case the table is left
+** as it was.
+*/
+int sqlite3HashCompact(Hash *pH){
+  struct _ht *new_ht = 0;        /* The new bucket array */
+  unsigned int new_size = 0;     /* Number of buckets in new_ht */
+#if HASH_POOL_SLAB>0
+  HashSlab *pOld = pH->pSlab;    /* The slabs to release */
+  HashElem *pFree = pH->pFree;   /* Free list of the old slabs */
+  HashElem *elem, *aElem;
+  unsigned int i;
+#endif
+
+  assert( pH!=0 );
+  if( pH->count==0 ) return 1;
+  rehashStep(pH, pH->htsize);
+  if( pH->count>=10 ){
+    new_size = pH->count*2;
+    new_ht = allocBuckets(pH, &new_size);
+    if( new_ht==0 ) return 0;
+  }
+#if HASH_POOL_SLAB>0
+  pH->pSlab = 0;
+  pH->pFree = 0;
+  if( !hashSlabAlloc(pH, pH->count) ){
+    pH->pSlab = pOld;
+    pH->pFree = pFree;
+    hashFree(pH, new_ht);
+    return 0;
+  }
+  aElem = pH->pSlab->aElem;
+  for(elem=pH->first, i=0; elem; elem=elem->next, i++){
+    aElem[i] = *elem;
+    aElem[i].prev = i ? &aElem[i-1] : 0;
+    if( i ) aElem[i-1].next = &aElem[i];
+  }
+  assert( i==pH->count );
+  pH->pSlab->nUsed = i;
+  pH->first = aElem;
+  while( pOld ){
+    HashSlab *pNext = pOld->pNext;
+    hashFree(pH, pOld);
+    pOld = pNext;
+  }
+#endif
+  hashFree(pH, pH->ht);
+  pH->ht = 0;
+  pH->htsize = 0;
+  if( new_ht ) rebuildBuckets(pH, new_ht, new_size);
+  return 1;
+}
+
+/* Perform up to nBucket steps of an incremental rehash in progress.
+** Return TRUE if the rehash is still in progress afterwards.
+*/
+int sqlite3HashRehash(Hash *pH, int nBucket){
+  assert( pH!=0 );
+  return rehashStep(pH, nBucket>0 ? (unsigned int)nBucket : 0);
+}
+
+static long long hashTimeInMilliseconds(void){
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return ((long long)tv.tv_sec)*1000 + tv.tv_usec/1000;
+}
+
+/* Perform steps of an incremental rehash in progress, 100 buckets at a
+** time, for about ms milliseconds.  Return TRUE if the rehash is still
+** in progress afterwards.
+*/
+int sqlite3HashRehashMs(Hash *pH, int ms){
+  long long start = hashTimeInMilliseconds();
+  assert( pH!=0 );
+  while( rehashStep(pH, 100) ){
+    if( hashTimeInMilliseconds()-start>ms ) return 1;
+  }
   return 0;
 }
@@ -15,9 +15,47 @@
 #ifndef SQLITE_HASH_H
 #define SQLITE_HASH_H
 
+#include <stddef.h>
+
 /* Forward declarations of structures. */
 typedef struct Hash Hash;
 typedef struct HashElem HashElem;
+typedef struct HashMemMethods HashMemMethods;
+typedef struct HashKeyMethods HashKeyMethods;
+typedef struct HashSlab HashSlab;
+
+/*
+** The hash table gets all its memory through an instance of the following
+** structure, in the spirit of sqlite3_mem_methods, so that jemalloc, an
+** arena or a pool can be plugged in.  pAppData is passed to every method.
+** xSize returns the usable size of an allocation, which may be larger
+** than requested; when hash.c is built with HASH_BUCKET_MODULO, the
+** bucket array makes use of the extra space.  Otherwise bucket arrays
+** have a power of two size and xSize is not called.  xSize may be NULL
+** if the allocator can't tell.  xFree is never called with a NULL
+** pointer.
+**
+** The default methods are malloc() and free(), with the usable size
+** coming from malloc_usable_size() or malloc_size() where available.
+*/
+struct HashMemMethods {
+  void *(*xMalloc)(void *pAppData, size_t nByte);  /* Allocate memory */
+  void (*xFree)(void *pAppData, void *p);          /* Free a prior allocation */
+  size_t (*xSize)(void *pAppData, void *p);        /* Usable size of p */
+  void *pAppData;                                  /* Argument to methods */
+};
+
+/*
+** Tables of the SQLITE_HASH_CUSTOM key class hash and compare their keys
+** with an instance of the following structure.  Keys that compare equal
+** must have the same hash.  xCompare returns 0 if the keys are equal.
+*/
+struct HashKeyMethods {
+  unsigned int (*xHash)(void *pAppData, const void *pKey, int nKey);
+  int (*xCompare)(void *pAppData, const void *pKey1, int nKey1,
+                  const void *pKey2, int nKey2);
+  void *pAppData;                                  /* Argument to methods */
+};
 
 /* A complete hash table is an instance of the following structure.
 ** The internals of this structure are intended to be opaque -- client
@@ -39,6 +77,16 @@ typedef struct HashElem HashElem;
 ** Hash.ht table is never allocated because if there are few elements
 ** in the table, it is faster to do a linear search than to manage
 ** the hash table.
+**
+** When the table grows, the new bucket array is filled incrementally, a
+** few buckets at each insert or delete: Hash.htNew holds the Hash.htsizeNew
+** buckets of the new array, the first Hash.iRehash buckets of Hash.ht were
+** already moved there, and htNew is NULL when no rehash is in progress.
+**
+** Elements are not allocated one by one: they are carved out of slabs,
+** which Hash.pSlab lists, and deleted elements go on the Hash.pFree list
+** to be reused by the next inserts.  The slabs are only released when the
+** table is cleared.
 */
 typedef struct Hash {
   unsigned int htsize;      /* Number of buckets in the hash table */
@@ -48,6 +96,14 @@ typedef struct Hash {
     int count;                 /* Number of entries with this hash */
     HashElem *chain;           /* Pointer to first entry with this hash */
   } *ht;
+  unsigned int htsizeNew;   /* Number of buckets in htNew */
+  unsigned int iRehash;     /* Buckets of ht already moved to htNew */
+  struct _ht *htNew;        /* Bucket array being rehashed into, or NULL */
+  const HashMemMethods *pMem; /* Memory allocation methods */
+  unsigned char keyClass;   /* SQLITE_HASH_STRING, _BINARY or _CUSTOM */
+  const HashKeyMethods *pKeyMethods; /* Methods of SQLITE_HASH_CUSTOM keys */
+  HashSlab *pSlab;          /* Slabs the elements are allocated from */
+  HashElem *pFree;          /* Unused elements of the slabs */
 } hash_t;
 
 /* Each element in the hash table is an instance of the following 
@@ -60,6 +116,8 @@ struct HashElem {
   HashElem *next, *prev;       /* Next and previous elements in the table */
   void *data;                  /* Data associated with this element */
   const char *pKey;            /* Key associated with this element */
+  int nKey;                    /* Length of pKey in bytes */
+  unsigned int h;              /* Full hash of pKey */
 };
 
 /*
@@ -70,6 +128,100 @@ void *sqlite3HashInsert(Hash*, const char *pKey, void *pData);
 void *sqlite3HashFind(const Hash*, const char *pKey);
 void sqlite3HashClear(Hash*);
 
+/*
+** There are three kinds of keys, chosen per table.  String keys, the
+** default, are compared without regard to ASCII case.  Binary keys are
+** compared byte for byte and may hold NUL bytes: this is also the class
+** for case sensitive strings, which then compare at memcmp() speed.
+** Custom keys are hashed and compared by the HashKeyMethods passed to
+** sqlite3HashSetKeyMethods().  The key class of a table without entries
+** can be changed with sqlite3HashSetKeyClass() or sqlite3HashSetKeyMethods().
+**
+** Lookups branch on the key class once, outside of the loop over the
+** elements, so the string and binary classes compare keys inline and
+** only custom keys pay for calls through pointers.
+**
+** sqlite3HashInsertKey() and sqlite3HashFindKey() take the length of the
+** key in bytes and work with both classes; sqlite3HashInsert() and
+** sqlite3HashFind() take the length of a NUL terminated key from
+** strlen().  Keys are not copied in either case.
+*/
+#define SQLITE_HASH_STRING    3
+#define SQLITE_HASH_BINARY    4
+#define SQLITE_HASH_CUSTOM    5
+
+void sqlite3HashSetKeyClass(Hash*, int keyClass);
+void sqlite3HashSetKeyMethods(Hash*, const HashKeyMethods*);
+void *sqlite3HashInsertKey(Hash*, const void *pKey, int nKey, void *pData);
+void *sqlite3HashFindKey(const Hash*, const void *pKey, int nKey);
+
+/*
+** Batched lookups.  sqlite3HashFindBatch() looks up n keys, NUL
+** terminated or of anKey[] bytes if anKey is not NULL, and stores the
+** data of each (or NULL) in aData[].  It gives the same results as that
+** many calls to sqlite3HashFindKey(), but works on groups of keys so
+** that their cache misses on the buckets, elements and stored keys are
+** taken in parallel.  It pays off from a few dozen keys on tables that
+** do not fit in the cache.
+*/
+void sqlite3HashFindBatch(const Hash*, const char *const *azKey,
+                          const int *anKey, int n, void **aData);
+
+/*
+** The hash of a key as computed by a table, according to its key class.
+** Keys that the table finds equal have the same hash, so it can be used
+** to spread keys over several tables of the same class.
+*/
+unsigned int sqlite3HashKeyHash(const Hash*, const void *pKey, int nKey);
+
+/*
+** Incremental rehashing.  Inserts and deletes move a bounded number of
+** buckets, lookups never do, so that they keep working on a const Hash
+** (and under a shared lock).  A table that goes idle in the middle of a
+** rehash can be helped along with sqlite3HashRehash(), which moves up to
+** nBucket buckets, or sqlite3HashRehashMs(), which works for about ms
+** milliseconds.  Both return TRUE if the rehash is still in progress.
+*/
+int sqlite3HashRehash(Hash*, int nBucket);
+int sqlite3HashRehashMs(Hash*, int ms);
+
+/*
+** Capacity.  sqlite3HashReserve() makes room for nEntry entries at once:
+** the bucket array is allocated at the size the table would grow to by
+** then, and the elements for the missing entries are allocated in one
+** slab, so that loading that many keys does not rehash or allocate.
+** sqlite3HashInitSize() initializes a table with room for nEntry
+** entries, from the allocator set by sqlite3HashConfigMalloc().  Both
+** return 0 if the memory could not be allocated; the table is usable
+** either way.  Deleting every entry clears the table and its reserve.
+*/
+int sqlite3HashReserve(Hash*, unsigned int nEntry);
+int sqlite3HashInitSize(Hash*, unsigned int nEntry);
+
+/*
+** Shrinking.  A delete that leaves the bucket array less than 1/8 full
+** starts an incremental rehash to a smaller array, so a table that
+** drained does not keep a large sparse array (this also gives back the
+** room reserved for entries that were never inserted).  Elements freed
+** by deletes stay in the slabs of the table until it is cleared, or
+** until sqlite3HashCompact(), which also finishes any rehash and sizes
+** the bucket array to the entries, copies them to a single slab and
+** releases the rest.  It moves every element at once, and HashElem
+** pointers taken before it are no longer valid.  It returns 0 if memory
+** could not be allocated, leaving the table as it was.
+*/
+int sqlite3HashCompact(Hash*);
+
+/*
+** Memory allocation.  sqlite3HashConfigMalloc() sets the methods used by
+** the tables initialized from then on; sqlite3HashSetMem() sets those of
+** a single empty table.  Neither copies the HashMemMethods structure,
+** which must stay valid as long as a table uses it.  A NULL pointer
+** selects the default methods.
+*/
+void sqlite3HashConfigMalloc(const HashMemMethods*);
+void sqlite3HashSetMem(Hash*, const HashMemMethods*);
+
 /*
 ** Macros for looping over all elements of a hash table.  The idiom is
 ** like this:
@@ -85,8 +237,8 @@ void sqlite3HashClear(Hash*);
 #define sqliteHashFirst(H)  ((H)->first)
 #define sqliteHashNext(E)   ((E)->next)
 #define sqliteHashData(E)   ((E)->data)
-/* #define sqliteHashKey(E)    ((E)->pKey) // NOT USED */
-/* #define sqliteHashKeysize(E) ((E)->nKey)  // NOT USED */
+#define sqliteHashKey(E)    ((E)->pKey)
+#define sqliteHashKeysize(E) ((E)->nKey)
 
 /*
 ** Number of entries in a hash table
@@ -0,0 +1,102 @@
+/* ilist.c - An intrusive doubly linked list
+ *
+ * See ilist.h for the description of the data structure.
+ */
+
+#include "ilist.h"
+
+void ilist_init(ilist_t *list)
+{
+    list->head = list->tail = NULL;
+    list->len = 0;
+}
+
+void ilist_add_head(ilist_t *list, ilist_link_t *link)
+{
+    link->prev = NULL;
+    link->next = list->head;
+    if (list->head)
+        list->head->prev = link;
+    else
+        list->tail = link;
+    list->head = link;
+    list->len++;
+}
+
+void ilist_add(ilist_t *list, ilist_link_t *link)
+{
+    link->prev = list->tail;
+    link->next = NULL;
+    if (list->tail)
+        list->tail->next = link;
+    else
+        list->head = link;
+    list->tail = link;
+    list->len++;
+}
+
+void ilist_insert(ilist_t *list, ilist_link_t *old_link, ilist_link_t *link,
+                  int after)
+{
+    if (after) {
+        link->prev = old_link;
+        link->next = old_link->next;
+        if (list->tail == old_link)
+            list->tail = link;
+    } else {
+        link->next = old_link;
+        link->prev = old_link->prev;
+        if (list->head == old_link)
+            list->head = link;
+    }
+    if (link->prev != NULL)
+        link->prev->next = link;
+    if (link->next != NULL)
+        link->next->prev = link;
+    list->len++;
+}
+
+void ilist_remove(ilist_t *list, ilist_link_t *link)
+{
+    if (link->prev)
+        link->prev->next = link->next;
+    else
+        list->head = link->next;
+    if (link->next)
+        link->next->prev = link->prev;
+    else
+        list->tail = link->prev;
+    link->prev = link->next = NULL;
+    list->len--;
+}
+
+ilist_link_t *ilist_index(ilist_t *list, long index)
+{
+    ilist_link_t *n;
+
+    if (index < 0) {
+        index = (-index)-1;
+        n = list->tail;
+        while(index-- && n) n = n->prev;
+    } else {
+        n = list->head;
+        while(index-- && n) n = n->next;
+    }
+    return n;
+}
+
+void ilist_rotate(ilist_t *list)
+{
+    ilist_link_t *tail = list->tail;
+
+    if (list->len <= 1) return;
+
+    /* Detach current tail */
+    list->tail = tail->prev;
+    list->tail->next = NULL;
+    /* Move it as head */
+    list->head->prev = tail;
+    tail->prev = NULL;
+    tail->next = list->head;
+    list->head = tail;
+}
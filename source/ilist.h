@@ -0,0 +1,89 @@
+/* ilist.h - An intrusive doubly linked list
+ *
+ * With list_t every element costs two allocations, the object and the
+ * list_node_t pointing to it. Here the caller embeds an ilist_link_t in
+ * its own structure instead, and gets the structure back from a link
+ * with ilist_entry(), so the list itself never allocates:
+ *
+ * struct job {
+ *     int id;
+ *     ilist_link_t link;
+ * };
+ *
+ * ilist_add(&queue, &job->link);
+ * ilist_foreach(&queue, l) {
+ *     struct job *job = ilist_entry(l, struct job, link);
+ *     ...
+ * }
+ *
+ * The operations are the ones of list.c, working on links instead of
+ * values. An object can be on as many lists as it embeds links, but a
+ * given link can only be on one list at a time.
+ */
+
+#ifndef __ILIST_H__
+#define __ILIST_H__
+
+#include <stddef.h>
+
+typedef struct ilist_link {
+    struct ilist_link *prev;
+    struct ilist_link *next;
+} ilist_link_t;
+
+typedef struct ilist {
+    ilist_link_t *head;
+    ilist_link_t *tail;
+    unsigned long len;
+} ilist_t;
+
+/* Get a pointer to the structure of type 'type' embedding 'ptr' as its
+ * 'member' field. */
+#ifndef container_of
+#define container_of(ptr,type,member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+#define ilist_entry(link,type,member) container_of(link, type, member)
+
+/* Functions implemented as macros */
+#define ilist_size(l) ((l)->len)
+#define ilist_first(l) ((l)->head)
+#define ilist_last(l) ((l)->tail)
+#define ilist_prev(n) ((n)->prev)
+#define ilist_next(n) ((n)->next)
+
+/* Walk the links from head to tail (or tail to head). The _safe variant
+ * keeps the following link in 'tmp', so that the current one can be
+ * removed while walking. */
+#define ilist_foreach(l,n) \
+    for ((n) = (l)->head; (n) != NULL; (n) = (n)->next)
+#define ilist_foreach_reverse(l,n) \
+    for ((n) = (l)->tail; (n) != NULL; (n) = (n)->prev)
+#define ilist_foreach_safe(l,n,tmp) \
+    for ((n) = (l)->head; (n) != NULL && ((tmp) = (n)->next, 1); (n) = (tmp))
+
+/* Prototypes. None of these functions allocate memory, so none of them
+ * can fail. */
+
+/* Initialize an empty list, usually embedded in another structure. */
+void ilist_init(ilist_t *list);
+
+/* Link 'link' at the head or at the tail of the list. */
+void ilist_add_head(ilist_t *list, ilist_link_t *link);
+void ilist_add(ilist_t *list, ilist_link_t *link);
+
+/* Link 'link' after 'old_link' if 'after' is non zero, else before it. */
+void ilist_insert(ilist_t *list, ilist_link_t *old_link, ilist_link_t *link,
+                  int after);
+
+/* Unlink 'link' from the list. The object embedding it is left alone. */
+void ilist_remove(ilist_t *list, ilist_link_t *link);
+
+/* Return the link at the specified zero-based index, negative indexes
+ * counting from the tail as in list_index(), or NULL if out of range. */
+ilist_link_t *ilist_index(ilist_t *list, long index);
+
+/* Rotate the list removing the tail link and inserting it to the head. */
+void ilist_rotate(ilist_t *list);
+
+#endif /* __ILIST_H__ */
@@ -0,0 +1,164 @@
+/* intmap.c - A hash map keyed by 64-bit integers
+ *
+ * See intmap.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include "intmap.h"
+
+/* The smallest table. */
+#define INTMAP_MIN_CAPACITY 16
+
+/* At most 3/4 of the slots are used: linear probing needs more room than
+ * the groups of swiss.c to keep probe sequences short. */
+#define intmap_max_load(capacity) ((capacity) - (capacity)/4)
+
+#define intmap_capacity(m) ((m)->slots ? (m)->mask+1 : 0)
+
+/* The finalizer of SplitMix64: ids are often small or sequential, so all
+ * their bits must be mixed before the low ones pick a slot. */
+static uint64_t intmap_hash(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+/* Return the slot holding 'key', or the empty slot that ends its probe
+ * sequence. There is always one, as the map is never allowed to fill
+ * up. */
+static size_t intmap_find_index(const intmap_t *map, uint64_t key)
+{
+    size_t i = intmap_hash(key) & map->mask;
+
+    while (map->slots[i].data != NULL && map->slots[i].key != key)
+        i = (i + 1) & map->mask;
+    return i;
+}
+
+/* Move every key to a new table of 'capacity' slots. Returns 0 if the
+ * allocation fails. */
+static int intmap_resize(intmap_t *map, size_t capacity)
+{
+    intmap_slot_t *slots;
+    size_t old_capacity = intmap_capacity(map), i, j;
+    intmap_t old = *map;
+
+    if ((slots = calloc(capacity, sizeof(intmap_slot_t))) == NULL)
+        return 0;
+    map->slots = slots;
+    map->mask = capacity-1;
+    for (j = 0; j < old_capacity; j++) {
+        if (old.slots[j].data == NULL) continue;
+        i = intmap_find_index(map, old.slots[j].key);
+        map->slots[i] = old.slots[j];
+    }
+    free(old.slots);
+    return 1;
+}
+
+intmap_t *intmap_create(void)
+{
+    intmap_t *map;
+
+    if ((map = malloc(sizeof(*map))) == NULL)
+        return NULL;
+    map->slots = NULL;
+    intmap_clear(map);
+    return map;
+}
+
+void intmap_clear(intmap_t *map)
+{
+    free(map->slots);
+    map->slots = NULL;
+    map->mask = 0;
+    map->count = 0;
+}
+
+void intmap_free(intmap_t *map)
+{
+    free(map->slots);
+    free(map);
+}
+
+void *intmap_find(const intmap_t *map, uint64_t key)
+{
+    if (map->count == 0)
+        return NULL;
+    return map->slots[intmap_find_index(map, key)].data;
+}
+
+void *intmap_insert(intmap_t *map, uint64_t key, void *data)
+{
+    size_t i, capacity = intmap_capacity(map);
+
+    if (data == NULL)
+        return intmap_delete(map, key);
+    if (map->count) {
+        i = intmap_find_index(map, key);
+        if (map->slots[i].data != NULL) {
+            void *old = map->slots[i].data;
+            map->slots[i].data = data;
+            return old;
+        }
+    }
+    if (map->count+1 > intmap_max_load(capacity)) {
+        if (!intmap_resize(map, capacity ? capacity*2 : INTMAP_MIN_CAPACITY))
+            return data;
+    }
+    i = intmap_find_index(map, key);
+    map->slots[i].key = key;
+    map->slots[i].data = data;
+    map->count++;
+    return NULL;
+}
+
+/* Empty the slot of the key, then walk the rest of the run of used
+ * slots: a key whose home slot is not between the hole and its own slot
+ * (cyclically) can no longer be reached by its probe sequence, so it
+ * moves back into the hole, which moves to where it was. */
+void *intmap_delete(intmap_t *map, uint64_t key)
+{
+    size_t i, j, home;
+    void *data;
+
+    if (map->count == 0)
+        return NULL;
+    i = intmap_find_index(map, key);
+    if ((data = map->slots[i].data) == NULL)
+        return NULL;
+    map->count--;
+    for (j = (i + 1) & map->mask; map->slots[j].data != NULL;
+         j = (j + 1) & map->mask) {
+        home = intmap_hash(map->slots[j].key) & map->mask;
+        if (((j - home) & map->mask) >= ((j - i) & map->mask)) {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].data = NULL;
+    return data;
+}
+
+void intmap_rewind(const intmap_t *map, intmap_iter_t *iter)
+{
+    iter->map = map;
+    iter->pos = 0;
+}
+
+intmap_slot_t *intmap_next(intmap_iter_t *iter)
+{
+    const intmap_t *map = iter->map;
+    size_t capacity = intmap_capacity(map);
+
+    while (iter->pos < capacity) {
+        size_t i = iter->pos++;
+        if (map->slots[i].data != NULL)
+            return &map->slots[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,87 @@
+/* intmap.h - A hash map keyed by 64-bit integers
+ *
+ * Many maps are keyed by numeric ids, which used to be formatted as
+ * strings to be used with Hash, paying for the formatting, a string hash
+ * and a string comparison at every access. Here the keys are uint64_t
+ * values stored inline next to their data, in one flat array of slots
+ * probed linearly: a lookup mixes the key with a few multiplies and
+ * shifts, then compares integers in consecutive slots, which most of the
+ * time lie on the cache line of the first one.
+ *
+ * Every key is valid, 0 included. As with Hash, data may not be NULL: a
+ * slot with NULL data is empty, and inserting NULL removes the key.
+ * Removing a key moves back the keys that follow it in the probe
+ * sequence, so no deleted markers accumulate and lookups never get
+ * longer than after the inserts alone.
+ */
+
+#ifndef __INTMAP_H__
+#define __INTMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct intmap_slot {
+    uint64_t key;
+    void *data;                 /* NULL if the slot is empty */
+} intmap_slot_t;
+
+typedef struct intmap {
+    intmap_slot_t *slots;       /* capacity slots, or NULL */
+    size_t mask;                /* capacity-1, capacity being a power of two */
+    size_t count;               /* number of keys in the map */
+} intmap_t;
+
+typedef struct intmap_iter {
+    const intmap_t *map;
+    size_t pos;
+} intmap_iter_t;
+
+/* Functions implemented as macros */
+#define intmap_size(m) ((m)->count)
+
+/* Walk the map with an iterator in caller provided storage:
+ *
+ * intmap_foreach(map, iter, slot) {
+ *     doSomethingWith(slot->key, slot->data);
+ * }
+ */
+#define intmap_foreach(m,iter,slot) \
+    for (intmap_rewind((m), &(iter)); ((slot) = intmap_next(&(iter))) != NULL; )
+
+/* Prototypes */
+/* Create a new empty map. No memory is allocated for slots until the
+ * first insert.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new map. */
+intmap_t *intmap_create(void);
+
+/* Free the map. The data is not freed. */
+void intmap_free(intmap_t *map);
+
+/* Remove every key from the map and release its slots. */
+void intmap_clear(intmap_t *map);
+
+/* Associate 'data' with 'key'. If the key was already in the map its
+ * previous data is returned, otherwise NULL is returned. If 'data' is
+ * NULL the key is removed. If the map needs to grow and the allocation
+ * fails, 'data' is returned and the map is unchanged. */
+void *intmap_insert(intmap_t *map, uint64_t key, void *data);
+
+/* Return the data associated with 'key', or NULL if it is not in the
+ * map. */
+void *intmap_find(const intmap_t *map, uint64_t key);
+
+/* Remove 'key' from the map and return its data, or NULL if it was not
+ * in the map. */
+void *intmap_delete(intmap_t *map, uint64_t key);
+
+/* Initialize an iterator in caller provided storage. */
+void intmap_rewind(const intmap_t *map, intmap_iter_t *iter);
+
+/* Return the next slot of the iteration, or NULL when there are no more.
+ * The order is unspecified. The map must not be modified while it is
+ * iterated, as a removal can move keys back over the iterator. */
+intmap_slot_t *intmap_next(intmap_iter_t *iter);
+
+#endif /* __INTMAP_H__ */
@@ -30,8 +30,451 @@
 
 
 #include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "list.h"
 
+list_pool_t *list_pool_create(unsigned long slab_nodes)
+{
+    list_pool_t *pool;
+
+    if ((pool = malloc(sizeof(*pool))) == NULL)
+        return NULL;
+    pool->slabs = NULL;
+    pool->free_nodes = NULL;
+    pool->slab_nodes = slab_nodes ? slab_nodes : LIST_POOL_SLAB_NODES;
+    pool->avail = 0;
+    pool->refs = 1;
+    return pool;
+}
+
+void list_pool_release(list_pool_t *pool)
+{
+    list_slab_t *slab, *next;
+
+    if (--pool->refs) return;
+    slab = pool->slabs;
+    while(slab) {
+        next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(pool);
+}
+
+/* Get a node from the list allocator: the pool free list first, then the
+ * unused tail of the current slab, then a brand new slab. */
+static list_node_t *list_node_alloc(list_t *list)
+{
+    list_pool_t *pool = list->pool;
+    list_node_t *node;
+
+    if (list->tree)
+        return malloc(sizeof(list_inode_t));
+    if (pool == NULL)
+        return malloc(sizeof(list_node_t));
+    if ((node = pool->free_nodes) != NULL) {
+        pool->free_nodes = node->next;
+        return node;
+    }
+    if (pool->avail == 0) {
+        list_slab_t *slab;
+
+        slab = malloc(sizeof(*slab) +
+                      (pool->slab_nodes-1)*sizeof(list_node_t));
+        if (slab == NULL) return NULL;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->avail = pool->slab_nodes;
+    }
+    return &pool->slabs->nodes[pool->slab_nodes - pool->avail--];
+}
+
+/* Allocate 'count' nodes at once, chained through their next pointer.
+ * Pooled lists carve them from what is left of the current slab plus a
+ * single new slab. Plain and indexed lists, whose nodes must stay
+ * individually free()able, fall back to one malloc() per node: the
+ * allocator of a list never changes behind its back, as it decides
+ * which lists it can exchange nodes with.
+ * On out of memory nothing is allocated and NULL is returned. */
+static list_node_t *list_node_alloc_run(list_t *list, unsigned long count)
+{
+    list_pool_t *pool;
+    list_slab_t *slab = NULL;
+    list_node_t *run = NULL, **link = &run, *node;
+    unsigned long j, need;
+
+    if ((pool = list->pool) == NULL) {
+        for (j = 0; j < count; j++) {
+            if ((node = list_node_alloc(list)) == NULL) {
+                while (run) {
+                    node = run->next;
+                    free(run);
+                    run = node;
+                }
+                return NULL;
+            }
+            node->next = NULL;
+            *link = node;
+            link = &node->next;
+        }
+        return run;
+    }
+
+    /* A batch that does not fit in a regular slab gets its own slab,
+     * kept behind the current one so that its leftover is not lost. */
+    need = count > pool->avail ? count - pool->avail : 0;
+    if (need) {
+        slab = malloc(sizeof(*slab) + ((need > pool->slab_nodes ?
+                      need : pool->slab_nodes)-1)*sizeof(list_node_t));
+        if (slab == NULL) return NULL;
+    }
+    for (j = count-need; j > 0; j--) {
+        node = &pool->slabs->nodes[pool->slab_nodes - pool->avail--];
+        *link = node;
+        link = &node->next;
+    }
+    if (need > pool->slab_nodes) {
+        if (pool->slabs) {
+            slab->next = pool->slabs->next;
+            pool->slabs->next = slab;
+        } else {
+            slab->next = NULL;
+            pool->slabs = slab;
+        }
+        for (j = 0; j < need; j++) {
+            *link = &slab->nodes[j];
+            link = &slab->nodes[j].next;
+        }
+    } else if (need) {
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->avail = pool->slab_nodes;
+        for (j = 0; j < need; j++) {
+            node = &slab->nodes[pool->slab_nodes - pool->avail--];
+            *link = node;
+            link = &node->next;
+        }
+    }
+    *link = NULL;
+    return run;
+}
+
+static void list_node_release(list_t *list, list_node_t *node)
+{
+    list_pool_t *pool = list->pool;
+
+    if (pool == NULL) {
+        free(node);
+        return;
+    }
+    node->next = pool->free_nodes;
+    pool->free_nodes = node;
+}
+
+#define list_inode(n) ((list_inode_t*)(n))
+#define list_tree_size(n) ((n) ? (n)->size : 0)
+
+/* Treap priorities come from a per list xorshift generator. */
+static unsigned int list_tree_random(list_tree_t *tree)
+{
+    unsigned int x = tree->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return tree->seed = x;
+}
+
+/* Rotate 'x' above its parent, preserving the in-order sequence, and
+ * fix the subtree sizes of the two nodes involved. */
+static void list_tree_rotate_up(list_tree_t *tree, list_inode_t *x)
+{
+    list_inode_t *p = x->parent, *g = p->parent;
+
+    if (p->left == x) {
+        p->left = x->right;
+        if (x->right) x->right->parent = p;
+        x->right = p;
+    } else {
+        p->right = x->left;
+        if (x->left) x->left->parent = p;
+        x->left = p;
+    }
+    p->parent = x;
+    x->parent = g;
+    if (g == NULL)
+        tree->root = x;
+    else if (g->left == p)
+        g->left = x;
+    else
+        g->right = x;
+    x->size = p->size;
+    p->size = 1 + list_tree_size(p->left) + list_tree_size(p->right);
+}
+
+/* Add 'node', already linked between its prev and next, to the tree.
+ * The in-order neighbours of the node are exactly node->prev and
+ * node->next: if prev has no right child the node goes there, otherwise
+ * next is the leftmost node of that right subtree, so it has no left
+ * child and the node goes there. */
+static void list_tree_link(list_t *list, list_node_t *node)
+{
+    list_tree_t *tree = list->tree;
+    list_inode_t *n = list_inode(node), *p;
+
+    n->left = n->right = NULL;
+    n->size = 1;
+    n->priority = list_tree_random(tree);
+    if (node->prev && list_inode(node->prev)->right == NULL) {
+        p = list_inode(node->prev);
+        p->right = n;
+    } else if (node->next) {
+        p = list_inode(node->next);
+        p->left = n;
+    } else {
+        n->parent = NULL;
+        tree->root = n;
+        return;
+    }
+    n->parent = p;
+    for (; p; p = p->parent) p->size++;
+    while (n->parent && n->parent->priority < n->priority)
+        list_tree_rotate_up(tree, n);
+}
+
+/* Remove 'node' from the tree: rotate it down until it is a leaf, then
+ * cut it off. Its prev/next links are left alone. */
+static void list_tree_unlink(list_t *list, list_node_t *node)
+{
+    list_tree_t *tree = list->tree;
+    list_inode_t *n = list_inode(node), *p;
+
+    while (n->left || n->right) {
+        if (n->right == NULL ||
+            (n->left && n->left->priority > n->right->priority))
+            list_tree_rotate_up(tree, n->left);
+        else
+            list_tree_rotate_up(tree, n->right);
+    }
+    p = n->parent;
+    if (p == NULL)
+        tree->root = NULL;
+    else if (p->left == n)
+        p->left = NULL;
+    else
+        p->right = NULL;
+    for (; p; p = p->parent) p->size--;
+}
+
+static list_node_t *list_tree_select(list_tree_t *tree, unsigned long index)
+{
+    list_inode_t *n = tree->root;
+    unsigned long left;
+
+    while (n) {
+        left = list_tree_size(n->left);
+        if (index == left)
+            return &n->node;
+        if (index < left) {
+            n = n->left;
+        } else {
+            index -= left+1;
+            n = n->right;
+        }
+    }
+    return NULL;
+}
+
+/* Concatenate the trees 'a' and 'b', all of 'a' coming first. */
+static list_inode_t *list_tree_merge(list_inode_t *a, list_inode_t *b)
+{
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (a->priority > b->priority) {
+        a->right = list_tree_merge(a->right, b);
+        a->right->parent = a;
+        a->size = 1 + list_tree_size(a->left) + a->right->size;
+        return a;
+    } else {
+        b->left = list_tree_merge(a, b->left);
+        b->left->parent = b;
+        b->size = 1 + b->left->size + list_tree_size(b->right);
+        return b;
+    }
+}
+
+/* Split the tree 't' in '*l', holding its first 'k' nodes, and '*r'. */
+static void list_tree_split(list_inode_t *t, unsigned long k,
+                            list_inode_t **l, list_inode_t **r)
+{
+    if (t == NULL) {
+        *l = *r = NULL;
+        return;
+    }
+    if (list_tree_size(t->left) < k) {
+        list_tree_split(t->right, k - list_tree_size(t->left) - 1,
+                        &t->right, r);
+        if (t->right) t->right->parent = t;
+        *l = t;
+    } else {
+        list_tree_split(t->left, k, l, &t->left);
+        if (t->left) t->left->parent = t;
+        *r = t;
+    }
+    t->size = 1 + list_tree_size(t->left) + list_tree_size(t->right);
+}
+
+/* Rebuild the tree of an indexed list after its nodes were reordered,
+ * appending the nodes one by one in list order. */
+static void list_tree_rebuild(list_t *list)
+{
+    list_node_t *node;
+    list_inode_t *n;
+
+    list->tree->root = NULL;
+    for (node = list->head; node; node = node->next) {
+        if (node->prev) {
+            list_tree_link(list, node);
+            continue;
+        }
+        n = list_inode(node);
+        n->parent = n->left = n->right = NULL;
+        n->size = 1;
+        n->priority = list_tree_random(list->tree);
+        list->tree->root = n;
+    }
+}
+
+static void list_tree_set_root(list_tree_t *tree, list_inode_t *root)
+{
+    if (root) root->parent = NULL;
+    tree->root = root;
+}
+
+/* Bookkeeping of a list and its copy-on-write clones, see
+ * list_clone_cow(). 'lists' holds the lists currently sharing the nodes
+ * and is only used under 'lock', as a clone may be freed by another
+ * thread while a sharer is changed. 'refs' counts the lists still
+ * holding the structure: a list leaves 'lists' under the lock and drops
+ * its reference once unlocked, so whoever drops the last one can free
+ * the structure knowing nobody else uses it. */
+struct list_share {
+    pthread_mutex_t lock;
+    atomic_ulong refs;
+    unsigned long count;        /* lists in 'lists' */
+    unsigned long size;         /* allocated slots in 'lists' */
+    list_t **lists;
+};
+
+static list_share_t *list_share_create(list_t *list)
+{
+    list_share_t *share;
+
+    if ((share = malloc(sizeof(*share))) == NULL)
+        return NULL;
+    if ((share->lists = malloc(sizeof(list_t*)*2)) == NULL) {
+        free(share);
+        return NULL;
+    }
+    pthread_mutex_init(&share->lock, NULL);
+    atomic_init(&share->refs, 1);
+    share->count = 1;
+    share->size = 2;
+    share->lists[0] = list;
+    return share;
+}
+
+static void list_share_release(list_share_t *share)
+{
+    if (atomic_fetch_sub(&share->refs, 1) != 1) return;
+    pthread_mutex_destroy(&share->lock);
+    free(share->lists);
+    free(share);
+}
+
+/* Remove 'list' from the sharers and return how many are left. Called
+ * with the lock held. */
+static unsigned long list_share_leave(list_share_t *share, list_t *list)
+{
+    unsigned long j = 0;
+
+    while (share->lists[j] != list) j++;
+    share->lists[j] = share->lists[--share->count];
+    return share->count;
+}
+
+/* Stop sharing the nodes of 'list' with copy-on-write clones, before it
+ * is changed. The list keeps its nodes, so the node pointers held by the
+ * caller stay valid: the other lists sharing them get a private copy
+ * instead, duplicating the values with the dup method if set, which they
+ * keep sharing among themselves. On out of memory 0 is returned and
+ * nothing changes. */
+static int list_unshare(list_t *list)
+{
+    list_share_t *share = list->share;
+    list_node_t *node, *copy, *head = NULL, *tail = NULL;
+    list_inode_t *root = NULL;
+    list_t *other;
+    unsigned long j;
+
+    if (share == NULL)
+        return 1;
+    /* Only this list can add sharers, so if it is the last one left
+     * nobody else touches the structure anymore. */
+    if (atomic_load(&share->refs) == 1)
+        goto done;
+    pthread_mutex_lock(&share->lock);
+    if (share->count > 1) {
+        for (node = list->head; node; node = node->next) {
+            if ((copy = list_node_alloc(list)) == NULL)
+                goto oom;
+            copy->value = node->value;
+            if (list->dup &&
+                (copy->value = list->dup(node->value)) == NULL) {
+                list_node_release(list, copy);
+                goto oom;
+            }
+            copy->prev = tail;
+            copy->next = NULL;
+            if (tail)
+                tail->next = copy;
+            else
+                head = copy;
+            tail = copy;
+        }
+        for (j = 0; j < share->count; j++) {
+            if ((other = share->lists[j]) == list) continue;
+            other->head = head;
+            other->tail = tail;
+            if (other->tree == NULL) continue;
+            if (root == NULL) {
+                list_tree_rebuild(other);
+                root = other->tree->root;
+            } else {
+                other->tree->root = root;
+            }
+        }
+    }
+    list_share_leave(share, list);
+    pthread_mutex_unlock(&share->lock);
+
+done:
+    list->share = NULL;
+    list_share_release(share);
+    return 1;
+
+oom:
+    pthread_mutex_unlock(&share->lock);
+    while (head) {
+        node = head->next;
+        if (list->dup && list->free) list->free(head->value);
+        list_node_release(list, head);
+        head = node;
+    }
+    return 0;
+}
+
 list_t *list_create(void)
 {
     list_t *list;
@@ -43,22 +486,74 @@ list_t *list_create(void)
     list->dup = NULL;
     list->free = NULL;
     list->match = NULL;
+    list->pool = NULL;
+    list->tree = NULL;
+    list->share = NULL;
+    return list;
+}
+
+list_t *list_create_indexed(void)
+{
+    list_t *list;
+
+    if ((list = list_create()) == NULL)
+        return NULL;
+    if ((list->tree = malloc(sizeof(*list->tree))) == NULL) {
+        free(list);
+        return NULL;
+    }
+    list->tree->root = NULL;
+    list->tree->seed = 2463534242U;
+    return list;
+}
+
+list_t *list_create_pooled(list_pool_t *pool)
+{
+    list_t *list;
+
+    if ((list = list_create()) == NULL)
+        return NULL;
+    if (pool == NULL) {
+        if ((pool = list_pool_create(0)) == NULL) {
+            free(list);
+            return NULL;
+        }
+    } else {
+        pool->refs++;
+    }
+    list->pool = pool;
     return list;
 }
 
 void list_free(list_t *list)
 {
-    unsigned long len;
+    list_share_t *share = list->share;
+    unsigned long len, sharers = 0;
     list_node_t *current, *next;
 
+    if (share) {
+        pthread_mutex_lock(&share->lock);
+        sharers = list_share_leave(share, list);
+        pthread_mutex_unlock(&share->lock);
+        list_share_release(share);
+    }
+    /* Nodes still shared with a clone belong to the clone, and nodes of
+     * a pool nobody else uses go away with its slabs. */
+    if (sharers)
+        len = 0;
+    else if (list->pool && list->pool->refs == 1 && list->free == NULL)
+        len = 0;
+    else
+        len = list->len;
     current = list->head;
-    len = list->len;
     while(len--) {
         next = current->next;
         if (list->free) list->free(current->value);
-        free(current);
+        list_node_release(list, current);
         current = next;
     }
+    if (list->pool) list_pool_release(list->pool);
+    free(list->tree);
     free(list);
 }
 
@@ -66,7 +561,9 @@ list_t *list_add_head(list_t *list, void *value)
 {
     list_node_t *node;
 
-    if ((node = malloc(sizeof(*node))) == NULL)
+    if (!list_unshare(list))
+        return NULL;
+    if ((node = list_node_alloc(list)) == NULL)
         return NULL;
     node->value = value;
     if (list->len == 0) {
@@ -78,6 +575,7 @@ list_t *list_add_head(list_t *list, void *value)
         list->head->prev = node;
         list->head = node;
     }
+    if (list->tree) list_tree_link(list, node);
     list->len++;
     return list;
 }
@@ -86,7 +584,9 @@ list_t *list_add(list_t *list, void *value)
 {
     list_node_t *node;
 
-    if ((node = malloc(sizeof(*node))) == NULL)
+    if (!list_unshare(list))
+        return NULL;
+    if ((node = list_node_alloc(list)) == NULL)
         return NULL;
     node->value = value;
     if (list->len == 0) {
@@ -98,15 +598,71 @@ list_t *list_add(list_t *list, void *value)
         list->tail->next = node;
         list->tail = node;
     }
+    if (list->tree) list_tree_link(list, node);
     list->len++;
     return list;
 }
 
+/* Link 'count' values at the head or at the tail of the list, keeping
+ * their order, in one pass and with a single length update. Pooled lists
+ * carve the nodes from one slab, other lists allocate them one by one,
+ * see list_node_alloc_run(). */
+static list_t *list_add_run(list_t *list, void **values, unsigned long count,
+                            int head)
+{
+    list_node_t *run, *node;
+    unsigned long j;
+
+    if (count == 0) return list;
+    if (!list_unshare(list))
+        return NULL;
+    if ((run = list_node_alloc_run(list, count)) == NULL)
+        return NULL;
+    for (j = 0; j < count; j++) {
+        node = run;
+        run = run->next;
+        if (head) {
+            node->value = values[count-1-j];
+            node->prev = NULL;
+            node->next = list->head;
+            if (list->head)
+                list->head->prev = node;
+            else
+                list->tail = node;
+            list->head = node;
+        } else {
+            node->value = values[j];
+            node->prev = list->tail;
+            node->next = NULL;
+            if (list->tail)
+                list->tail->next = node;
+            else
+                list->head = node;
+            list->tail = node;
+        }
+        if (list->tree) list_tree_link(list, node);
+    }
+    list->len += count;
+    return list;
+}
+
+list_t *list_add_head_bulk(list_t *list, void **values, unsigned long count)
+{
+    return list_add_run(list, values, count, 1);
+}
+
+list_t *list_add_bulk(list_t *list, void **values, unsigned long count)
+{
+    return list_add_run(list, values, count, 0);
+}
+
 list_t *list_insert(list_t *list, list_node_t *old_node, void *value, int after) 
 {
     list_node_t *node;
 
-    if ((node = malloc(sizeof(*node))) == NULL)
+    if (!list_unshare(list))
+        return NULL;
+    if ((node = list_node_alloc(list)) == NULL)
         return NULL;
     node->value = value;
     if (after) {
@@ -128,12 +684,15 @@ list_t *list_insert(list_t *list, list_node_t *old_node, void *value, int after)
     if (node->next != NULL) {
         node->next->prev = node;
     }
+    if (list->tree) list_tree_link(list, node);
     list->len++;
     return list;
 }
 
 void list_remove(list_t *list, list_node_t *node)
 {
+    if (!list_unshare(list)) return;
+    if (list->tree) list_tree_unlink(list, node);
     if (node->prev)
         node->prev->next = node->next;
     else
@@ -143,7 +702,7 @@ void list_remove(list_t *list, list_node_t *node)
     else
         list->tail = node->prev;
     if (list->free) list->free(node->value);
-    free(node);
+    list_node_release(list, node);
     list->len--;
 }
 
@@ -193,57 +752,101 @@ list_node_t *list_next(list_iter_t *iter)
 list_t *list_clone(list_t *orig)
 {
     list_t *copy;
-    list_iter_t *iter;
+    list_iter_t iter;
     list_node_t *node;
 
-    if ((copy = list_create()) == NULL)
+    if (orig->tree)
+        copy = list_create_indexed();
+    else if (orig->pool)
+        copy = list_create_pooled(orig->pool);
+    else
+        copy = list_create();
+    if (copy == NULL)
         return NULL;
     copy->dup = orig->dup;
     copy->free = orig->free;
     copy->match = orig->match;
-    iter = list_iterator(orig, _START_HEAD);
-    while((node = list_next(iter)) != NULL) {
+    list_rewind(orig, &iter);
+    while((node = list_next(&iter)) != NULL) {
         void *value;
 
         if (copy->dup) {
             value = copy->dup(node->value);
             if (value == NULL) {
                 list_free(copy);
-                list_free_iterator(iter);
                 return NULL;
             }
         } else
             value = node->value;
         if (list_add(copy, value) == NULL) {
             list_free(copy);
-            list_free_iterator(iter);
             return NULL;
         }
     }
-    list_free_iterator(iter);
+    return copy;
+}
+
+list_t *list_clone_cow(list_t *orig)
+{
+    list_share_t *share;
+    list_t *copy, **lists;
+
+    if ((copy = list_create()) == NULL)
+        return NULL;
+    if (orig->tree && (copy->tree = malloc(sizeof(*copy->tree))) == NULL) {
+        free(copy);
+        return NULL;
+    }
+    if (orig->share == NULL &&
+        (orig->share = list_share_create(orig)) == NULL) {
+        free(copy->tree);
+        free(copy);
+        return NULL;
+    }
+    share = orig->share;
+    pthread_mutex_lock(&share->lock);
+    if (share->count == share->size) {
+        lists = realloc(share->lists, sizeof(list_t*)*share->size*2);
+        if (lists == NULL) {
+            pthread_mutex_unlock(&share->lock);
+            free(copy->tree);
+            free(copy);
+            return NULL;
+        }
+        share->lists = lists;
+        share->size *= 2;
+    }
+    share->lists[share->count++] = copy;
+    atomic_fetch_add(&share->refs, 1);
+    /* Another sharer being changed may hand 'orig' new nodes, under the
+     * lock. */
+    if (orig->tree) *copy->tree = *orig->tree;
+    copy->head = orig->head;
+    copy->tail = orig->tail;
+    copy->len = orig->len;
+    pthread_mutex_unlock(&share->lock);
+    copy->dup = orig->dup;
+    copy->free = orig->free;
+    copy->match = orig->match;
+    if ((copy->pool = orig->pool) != NULL)
+        copy->pool->refs++;
+    copy->share = share;
     return copy;
 }
 
 list_node_t *list_search(list_t *list, void *key)
 {
-    list_iter_t *iter;
     list_node_t *node;
 
-    iter = list_iterator(list, _START_HEAD);
-    while((node = list_next(iter)) != NULL) {
+    list_foreach(list, node) {
         if (list->match) {
-            if (list->match(node->value, key)) {
-                list_free_iterator(iter);
+            if (list->match(node->value, key))
                 return node;
-            }
         } else {
-            if (key == node->value) {
-                list_free_iterator(iter);
+            if (key == node->value)
                 return node;
-            }
         }
     }
-    list_free_iterator(iter);
     return NULL;
 }
 
@@ -251,6 +854,11 @@ list_node_t *list_index(list_t *list, long index)
 {
     list_node_t *n;
 
+    if (list->tree) {
+        if (index < 0) index += (long)list->len;
+        if (index < 0 || (unsigned long)index >= list->len) return NULL;
+        return list_tree_select(list->tree, index);
+    }
     if (index < 0) {
         index = (-index)-1;
         n = list->tail;
@@ -262,12 +870,343 @@ list_node_t *list_index(list_t *list, long index)
     return n;
 }
 
+unsigned long list_rank(list_t *list, list_node_t *node)
+{
+    unsigned long rank = 0;
+
+    if (list->tree) {
+        list_inode_t *n = list_inode(node);
+
+        rank = list_tree_size(n->left);
+        for (; n->parent; n = n->parent) {
+            if (n->parent->right == n)
+                rank += list_tree_size(n->parent->left) + 1;
+        }
+    } else {
+        while ((node = node->prev) != NULL) rank++;
+    }
+    return rank;
+}
+
+/* Nodes can only move between lists sharing the same node allocator.
+ * An empty list switches to the allocator of 'src' on the fly. */
+static int list_can_take_nodes(list_t *dst, list_t *src)
+{
+    if (dst == src || (dst->tree == NULL) != (src->tree == NULL))
+        return 0;
+    if (dst->pool == src->pool)
+        return 1;
+    if (dst->len)
+        return 0;
+    if (src->pool) src->pool->refs++;
+    if (dst->pool) list_pool_release(dst->pool);
+    dst->pool = src->pool;
+    return 1;
+}
+
+/* Number of nodes from 'node' to the tail. Walking from the node toward
+ * both ends at once, this costs min(rank, len-rank) steps. */
+static unsigned long list_count_to_tail(list_t *list, list_node_t *node)
+{
+    list_node_t *fwd = node, *back = node->prev;
+    unsigned long steps = 0;
+
+    if (list->tree) return list->len - list_rank(list, node);
+    while (1) {
+        if (fwd == NULL) return steps;
+        if (back == NULL) return list->len - steps;
+        fwd = fwd->next;
+        back = back->prev;
+        steps++;
+    }
+}
+
+list_t *list_join(list_t *list, list_t *other)
+{
+    if (list == other || !list_unshare(list) || !list_unshare(other))
+        return NULL;
+    if (!list_can_take_nodes(list, other))
+        return NULL;
+    if (other->len == 0)
+        return list;
+    if (list->tree) {
+        list_tree_set_root(list->tree,
+            list_tree_merge(list->tree->root, other->tree->root));
+        other->tree->root = NULL;
+    }
+    if (list->len == 0) {
+        list->head = other->head;
+    } else {
+        list->tail->next = other->head;
+        other->head->prev = list->tail;
+    }
+    list->tail = other->tail;
+    list->len += other->len;
+    other->head = other->tail = NULL;
+    other->len = 0;
+    return list;
+}
+
+list_t *list_splice(list_t *dst, list_node_t *where, list_t *src,
+                    list_node_t *first, list_node_t *last,
+                    unsigned long count)
+{
+    list_node_t *node;
+
+    if (dst == src)
+        return NULL;
+    /* If the two lists share their nodes, 'src' keeps them along with
+     * 'first' and 'last', and 'where' is found again in the copy handed
+     * to 'dst'. */
+    if (dst->share && dst->share == src->share) {
+        unsigned long pos = where ? list_rank(dst, where) : 0;
+
+        if (!list_unshare(src))
+            return NULL;
+        if (where) where = list_index(dst, pos);
+    }
+    if (!list_unshare(dst) || !list_unshare(src))
+        return NULL;
+    if (!list_can_take_nodes(dst, src))
+        return NULL;
+    if (src->tree) {
+        list_inode_t *before, *range, *after;
+        unsigned long rank = list_rank(src, first);
+        unsigned long pos = where ? list_rank(dst, where)+1 : 0;
+
+        count = list_rank(src, last) - rank + 1;
+        list_tree_split(src->tree->root, rank, &before, &after);
+        list_tree_split(after, count, &range, &after);
+        list_tree_set_root(src->tree, list_tree_merge(before, after));
+        list_tree_split(dst->tree->root, pos, &before, &after);
+        list_tree_set_root(dst->tree,
+            list_tree_merge(list_tree_merge(before, range), after));
+    } else if (count == 0) {
+        for (count = 1, node = first; node != last; node = node->next)
+            count++;
+    }
+
+    /* Detach the range from 'src'... */
+    if (first->prev)
+        first->prev->next = last->next;
+    else
+        src->head = last->next;
+    if (last->next)
+        last->next->prev = first->prev;
+    else
+        src->tail = first->prev;
+    src->len -= count;
+
+    /* ...and link it after 'where' in 'dst'. */
+    first->prev = where;
+    last->next = where ? where->next : dst->head;
+    if (where)
+        where->next = first;
+    else
+        dst->head = first;
+    if (last->next)
+        last->next->prev = last;
+    else
+        dst->tail = last;
+    dst->len += count;
+    return dst;
+}
+
+list_t *list_split_at(list_t *list, list_node_t *node)
+{
+    list_t *rest;
+    unsigned long count;
+
+    if (!list_unshare(list))
+        return NULL;
+    if (list->tree)
+        rest = list_create_indexed();
+    else if (list->pool)
+        rest = list_create_pooled(list->pool);
+    else
+        rest = list_create();
+    if (rest == NULL)
+        return NULL;
+    rest->dup = list->dup;
+    rest->free = list->free;
+    rest->match = list->match;
+
+    count = list_count_to_tail(list, node);
+    if (list->tree) {
+        list_inode_t *before, *after;
+
+        list_tree_split(list->tree->root, list->len - count,
+                        &before, &after);
+        list_tree_set_root(list->tree, before);
+        list_tree_set_root(rest->tree, after);
+    }
+    rest->head = node;
+    rest->tail = list->tail;
+    rest->len = count;
+    list->tail = node->prev;
+    if (node->prev)
+        node->prev->next = NULL;
+    else
+        list->head = NULL;
+    node->prev = NULL;
+    list->len -= count;
+    return rest;
+}
+
+/* Merge two NULL terminated chains sorted by 'cmp', linked through their
+ * next pointers only. Ties are taken from 'a' first, so it is stable. */
+static list_node_t *list_merge_chains(list_node_t *a, list_node_t *b,
+                                      int (*cmp)(void *a, void *b))
+{
+    list_node_t *head = NULL, **link = &head;
+
+    while (a && b) {
+        if (cmp(a->value, b->value) <= 0) {
+            *link = a;
+            a = a->next;
+        } else {
+            *link = b;
+            b = b->next;
+        }
+        link = &(*link)->next;
+    }
+    *link = a ? a : b;
+    return head;
+}
+
+/* Bottom-up merge sort of a NULL terminated chain linked through next.
+ * bins[i] holds either nothing or a sorted run of 2^i nodes: every node
+ * taken from the input is carried up through the bins like a binary
+ * counter, merging with the runs it meets. Merges work on recently
+ * touched nodes, which is cache friendly, and the bins live on the
+ * stack, so nothing is allocated. Bins hold older nodes than the carry,
+ * which keeps the sort stable. */
+static list_node_t *list_sort_chain(list_node_t *head,
+                                    int (*cmp)(void *a, void *b))
+{
+    list_node_t *bins[64], *carry;
+    int i, used = 0;
+
+    while (head) {
+        carry = head;
+        head = head->next;
+        carry->next = NULL;
+        for (i = 0; i < used && bins[i]; i++) {
+            carry = list_merge_chains(bins[i], carry, cmp);
+            bins[i] = NULL;
+        }
+        bins[i] = carry;
+        if (i == used) used++;
+    }
+    for (carry = NULL, i = 0; i < used; i++) {
+        if (bins[i]) carry = list_merge_chains(bins[i], carry, cmp);
+    }
+    return carry;
+}
+
+/* Make 'head', a sorted chain of all the list nodes, the list again:
+ * restore prev links and the tail, and the tree of indexed lists. */
+static void list_sorted_relink(list_t *list, list_node_t *head)
+{
+    list_node_t *prev = NULL, *node;
+
+    for (node = head; node; node = node->next) {
+        node->prev = prev;
+        prev = node;
+    }
+    list->head = head;
+    list->tail = prev;
+    if (list->tree) list_tree_rebuild(list);
+}
+
+void list_sort(list_t *list, int (*cmp)(void *a, void *b))
+{
+    if (list->len <= 1 || !list_unshare(list)) return;
+    list_sorted_relink(list, list_sort_chain(list->head, cmp));
+}
+
+typedef struct list_sort_job {
+    list_node_t *chain;
+    int (*cmp)(void *a, void *b);
+} list_sort_job_t;
+
+static void *list_sort_thread(void *arg)
+{
+    list_sort_job_t *job = arg;
+
+    job->chain = list_sort_chain(job->chain, job->cmp);
+    return NULL;
+}
+
+/* Below this many nodes per thread starting threads is not worth it. */
+#define LIST_SORT_MIN_CHUNK 4096
+
+void list_sort_parallel(list_t *list, int (*cmp)(void *a, void *b),
+                        int threads)
+{
+    list_sort_job_t jobs[LIST_SORT_MAX_THREADS];
+    pthread_t tids[LIST_SORT_MAX_THREADS];
+    int started[LIST_SORT_MAX_THREADS];
+    list_node_t *node;
+    unsigned long parts, chunk, i;
+    int j, step;
+
+    /* Any count below 2 means sorting here, and the count is clamped in
+     * unsigned arithmetic, where a negative one would be huge. */
+    parts = threads > 1 ? (unsigned long)threads : 1;
+    if (parts > list->len / LIST_SORT_MIN_CHUNK)
+        parts = list->len / LIST_SORT_MIN_CHUNK;
+    if (parts > LIST_SORT_MAX_THREADS) parts = LIST_SORT_MAX_THREADS;
+    if (parts <= 1) {
+        list_sort(list, cmp);
+        return;
+    }
+    threads = (int)parts;
+    if (!list_unshare(list)) return;
+
+    /* Cut the list in 'threads' chains and sort each in its own thread,
+     * or in this one if the thread can't be started. */
+    chunk = (list->len + threads - 1) / threads;
+    node = list->head;
+    for (j = 0; j < threads; j++) {
+        jobs[j].chain = node;
+        jobs[j].cmp = cmp;
+        for (i = 1; i < chunk && node->next; i++) node = node->next;
+        if (j < threads-1) {
+            list_node_t *next = node->next;
+
+            node->next = NULL;
+            node = next;
+        }
+    }
+    for (j = 0; j < threads; j++)
+        started[j] = pthread_create(&tids[j], NULL, list_sort_thread,
+                                    &jobs[j]) == 0;
+    for (j = 0; j < threads; j++) {
+        if (started[j])
+            pthread_join(tids[j], NULL);
+        else
+            list_sort_thread(&jobs[j]);
+    }
+
+    /* Merge the sorted chains pairwise, neighbours first so the sort
+     * stays stable. */
+    for (step = 1; step < threads; step *= 2) {
+        for (j = 0; j + step < threads; j += 2*step)
+            jobs[j].chain = list_merge_chains(jobs[j].chain,
+                                              jobs[j+step].chain, cmp);
+    }
+    list_sorted_relink(list, jobs[0].chain);
+}
+
 void list_rotate(list_t *list) 
 {
-    list_node_t *tail = list->tail;
+    list_node_t *tail;
 
-    if (list_size(list) <= 1) return;
+    if (list_size(list) <= 1 || !list_unshare(list)) return;
+    tail = list->tail;
 
+    if (list->tree) list_tree_unlink(list, tail);
     /* Detach current tail */
     list->tail = tail->prev;
     list->tail->next = NULL;
@@ -276,4 +1215,5 @@ void list_rotate(list_t *list)
     tail->prev = NULL;
     tail->next = list->head;
     list->head = tail;
+    if (list->tree) list_tree_link(list, tail);
 }
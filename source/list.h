@@ -39,6 +39,50 @@ typedef struct list_node {
     void *value;
 } list_node_t;
 
+/* Node pool. Nodes are carved out of large slabs and recycled through a
+ * free list, so pooled lists do not hit malloc()/free() per node. Slabs
+ * are only released when the last reference to the pool goes away. */
+typedef struct list_slab {
+    struct list_slab *next;
+    list_node_t nodes[1];
+} list_slab_t;
+
+typedef struct list_pool {
+    list_slab_t *slabs;
+    list_node_t *free_nodes;
+    unsigned long slab_nodes;
+    unsigned long avail;
+    unsigned long refs;
+} list_pool_t;
+
+/* Default number of nodes carved from a single slab. */
+#define LIST_POOL_SLAB_NODES 1024
+
+/* Indexed lists. Every node of an indexed list is a list_inode_t, whose
+ * first member is the plain list_node_t handed out by the API, and the
+ * nodes are also kept in an implicit treap ordered by list position,
+ * where each subtree knows its size. This makes list_index(), list_rank()
+ * and so positional inserts O(log n), while prev/next still make
+ * iteration O(1) per node. */
+typedef struct list_inode {
+    list_node_t node;
+    struct list_inode *parent;
+    struct list_inode *left;
+    struct list_inode *right;
+    unsigned long size;
+    unsigned int priority;
+} list_inode_t;
+
+typedef struct list_tree {
+    list_inode_t *root;
+    unsigned int seed;
+} list_tree_t;
+
+/* Bookkeeping shared by a list and its copy-on-write clones, see
+ * list_clone_cow(). The structure is private to list.c, as it holds a
+ * lock and C11 atomics. */
+typedef struct list_share list_share_t;
+
 typedef struct list_iter {
     list_node_t *next;
     int direction;
@@ -50,6 +94,9 @@ typedef struct list {
     void *(*dup)(void *ptr);
     void (*free)(void *ptr);
     int (*match)(void *ptr, void *key);
+    list_pool_t *pool;
+    list_tree_t *tree;
+    list_share_t *share;
     unsigned long len;
 } list_t;
 
@@ -61,6 +108,22 @@ typedef struct list {
 //#define list_next(n) ((n)->next)
 #define list_value(n) ((n)->value)
 
+/* Walk the list from head to tail (or tail to head) without allocating
+ * an iterator:
+ *
+ * list_foreach(list, node) {
+ *     doSomethingWith(list_value(node));
+ * }
+ *
+ * The _safe variant keeps the following node in 'tmp', so the current
+ * node can be removed with list_remove() while walking. */
+#define list_foreach(l,n) \
+    for ((n) = (l)->head; (n) != NULL; (n) = (n)->next)
+#define list_foreach_reverse(l,n) \
+    for ((n) = (l)->tail; (n) != NULL; (n) = (n)->prev)
+#define list_foreach_safe(l,n,tmp) \
+    for ((n) = (l)->head; (n) != NULL && ((tmp) = (n)->next, 1); (n) = (tmp))
+
 #define list_set_clone_method(l,m) ((l)->dup = (m))
 #define list_set_free_method(l,m) ((l)->free = (m))
 #define list_set_match_method(l,m) ((l)->match = (m))
@@ -77,6 +140,33 @@ typedef struct list {
  * On error, NULL is returned. Otherwise the pointer to the new list. */
 list_t *list_create(void);
 
+/* Create a new list whose nodes are allocated from 'pool'. The list takes
+ * a reference on the pool, so several lists can share the same pool and
+ * the caller may release its own reference right away. If 'pool' is NULL
+ * a private pool with the default slab size is created for the list.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new list. */
+list_t *list_create_pooled(list_pool_t *pool);
+
+/* Create a new indexed list: positional access with list_index() and
+ * list_rank() is O(log n) instead of O(n), at the cost of a bigger node
+ * (a list_inode_t) and O(log n) insertions and removals. Indexed lists
+ * allocate their nodes with malloc(), never from a pool.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new list. */
+list_t *list_create_indexed(void);
+
+/* Create a node pool carving 'slab_nodes' nodes per slab (0 means
+ * LIST_POOL_SLAB_NODES). The pool is returned with one reference held
+ * by the caller, to be dropped with list_pool_release().
+ *
+ * On error, NULL is returned. */
+list_pool_t *list_pool_create(unsigned long slab_nodes);
+
+/* Drop a reference to the pool. When the last list using the pool is
+ * freed and every reference is released, all the slabs are freed. */
+void list_pool_release(list_pool_t *pool);
+
 /* Free the whole list.
  * This function can't fail. */
 void list_free(list_t *list);
@@ -99,6 +189,18 @@ list_t *list_add_head(list_t *list, void *value);
 list_t *list_add(list_t *list, void *value);
 
 
+/* Add 'count' values from the 'values' array to the head or to the tail
+ * of the list, in array order (so values[0] becomes the head with
+ * list_add_head_bulk()). Pooled lists (see list_create_pooled()) carve
+ * all the nodes from a single slab, so the batch costs at most one
+ * malloc(). Plain and indexed lists keep their allocator and still
+ * allocate one node per value, but the nodes are linked in one pass.
+ *
+ * On error, NULL is returned and the list remains unaltered.
+ * On success the 'list' pointer you pass to the function is returned. */
+list_t *list_add_head_bulk(list_t *list, void **values, unsigned long count);
+list_t *list_add_bulk(list_t *list, void **values, unsigned long count);
+
 list_t *list_insert(list_t *list, list_node_t *old_node, void *value, int after);
 
 /* Remove the specified node from the specified list.
@@ -110,6 +212,8 @@ void list_remove(list_t *list, list_node_t *node);
 
 /* Returns a list iterator 'iter'. After the initialization every
  * call to listNext() will return the next element of the list.
+ * The iterator is heap allocated: use list_rewind() on a stack
+ * list_iter_t, or list_foreach(), to walk a list without allocating.
  *
  * This function can't fail. */
 list_iter_t *list_iterator(list_t *list, int direction);
@@ -140,9 +244,34 @@ void list_free_iterator(list_iter_t *iter);
  * to copy the node value. Otherwise the same pointer value of
  * the original node is used as value of the copied node.
  *
+ * The copy allocates its nodes from the same pool as the original, if any.
+ *
  * The original list both on success or error is never modified. */
 list_t *list_clone(list_t *orig);
 
+/* Copy-on-write clone: the returned list shares the nodes (and values)
+ * of 'orig' instead of copying them, so the clone is O(1). Reading either
+ * list leaves the nodes shared. The first mutation of a list still
+ * sharing its nodes gives the other lists a private copy, made exactly
+ * like list_clone() does, while the mutated list keeps its nodes: node
+ * pointers obtained from it stay valid, so it can be changed inside
+ * list_foreach_safe(), but those obtained from the other lists now
+ * belong to it. That mutation is O(n). If the copy can't be allocated
+ * the mutation fails: functions returning a pointer return NULL and the
+ * others do nothing.
+ *
+ * Values written in place through list_value() are seen by all the lists
+ * sharing the node.
+ *
+ * A clone may be freed by another thread while the original is changed,
+ * which the sharing bookkeeping is locked for. A clone can be read by
+ * another thread only as long as no list sharing its nodes is changed,
+ * as the change happens in place. Pooled lists can't be cloned across
+ * threads at all: the pool they share is not thread safe.
+ *
+ * On out of memory NULL is returned. */
+list_t *list_clone_cow(list_t *orig);
+
 /* Search the list for a node matching a given key.
  * The match is performed using the 'match' method
  * set with listSetMatchMethod(). If no 'match' method
@@ -159,14 +288,70 @@ list_node_t *list_search(list_t *list, void *key);
  * where 0 is the head, 1 is the element next to head
  * and so on. Negative integers are used in order to count
  * from the tail, -1 is the last element, -2 the penultimate
- * and so on. If the index is out of range NULL is returned. */
+ * and so on. If the index is out of range NULL is returned.
+ *
+ * This is O(log n) on indexed lists and O(n) otherwise. */
 list_node_t *list_index(list_t *list, long index);
 
+/* Return the zero-based position of 'node' in the list, the inverse of
+ * list_index(). This is O(log n) on indexed lists and O(n) otherwise. */
+unsigned long list_rank(list_t *list, list_node_t *node);
+
 
 /* Create an iterator in the list private iterator structure */
 void list_rewind(list_t *list, list_iter_t *li);
 void list_rewind_tail(list_t *list, list_iter_t *li);
 
+/* The following functions move nodes between lists by relinking them,
+ * without allocating or copying, so the node pointers stay valid and
+ * ownership of the values moves along. Both lists must allocate their
+ * nodes the same way (both plain, both from the same pool, or both
+ * indexed); an empty destination adopts the pool of the source. On a
+ * mismatch NULL is returned and nothing is done. On indexed lists the
+ * treaps are split and merged in O(log n). */
+
+/* Append all the nodes of 'other' to 'list', leaving 'other' empty but
+ * still allocated. This is O(1).
+ *
+ * On success the 'list' pointer is returned. */
+list_t *list_join(list_t *list, list_t *other);
+
+/* Move the nodes from 'first' to 'last' (inclusive, 'first' not after
+ * 'last') of 'src' into 'dst', right after 'where', or at the head of
+ * 'dst' if 'where' is NULL. 'count' is the number of nodes in the range,
+ * if the caller knows it: the move is then O(1). With a 'count' of 0 the
+ * range is walked once to count it, which is linear in its length on
+ * plain lists. Indexed lists ignore 'count' and find it in O(log n).
+ *
+ * On success the 'dst' pointer is returned. */
+list_t *list_splice(list_t *dst, list_node_t *where, list_t *src,
+                    list_node_t *first, list_node_t *last,
+                    unsigned long count);
+
+/* Cut 'list' right before 'node': the nodes from 'node' to the tail are
+ * moved to a new list, with the same methods and allocator, which is
+ * returned. Counting the moved nodes costs min(k, n-k) steps on plain
+ * lists and O(log n) on indexed ones.
+ *
+ * On out of memory NULL is returned and 'list' is not modified. */
+list_t *list_split_at(list_t *list, list_node_t *node);
+
+/* Sort the list in place with 'cmp', which compares two node values and
+ * returns <0, 0 or >0 like strcmp(). This is a stable bottom-up merge
+ * sort that only relinks the nodes: nothing is allocated and the node
+ * pointers stay valid. Indexed lists rebuild their tree afterwards. */
+void list_sort(list_t *list, int (*cmp)(void *a, void *b));
+
+/* Maximum number of threads used by list_sort_parallel(). */
+#define LIST_SORT_MAX_THREADS 64
+
+/* Like list_sort(), but the list is cut in up to 'threads' parts sorted
+ * by as many threads, then merged. 'cmp' must be thread safe. Small
+ * lists, and any 'threads' below 2, are sorted in the calling thread.
+ * The result is the same as list_sort(), stability included. */
+void list_sort_parallel(list_t *list, int (*cmp)(void *a, void *b),
+                        int threads);
+
 /* Rotate the list removing the tail node and inserting it to the head. */
 void list_rotate(list_t *list);
 
@@ -0,0 +1,137 @@
+/* queue.c - A lock-free bounded multi-producer multi-consumer queue
+ *
+ * See queue.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "queue.h"
+
+#define QUEUE_CACHE_LINE 64
+
+/* A cell is free for the producer at position 'pos' when its sequence is
+ * 'pos', and holds a value for the consumer at position 'pos' when its
+ * sequence is 'pos+1'. Consuming it makes it free for the producer one
+ * lap later, at 'pos+capacity'. */
+typedef struct queue_cell {
+    atomic_size_t seq;
+    void *value;
+} queue_cell_t;
+
+/* The two positions live on their own cache line so that producers and
+ * consumers do not invalidate each other's line on every operation. */
+struct queue {
+    queue_cell_t *cells;
+    size_t mask;
+    char pad0[QUEUE_CACHE_LINE - sizeof(queue_cell_t*) - sizeof(size_t)];
+    atomic_size_t tail;
+    char pad1[QUEUE_CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t head;
+    char pad2[QUEUE_CACHE_LINE - sizeof(atomic_size_t)];
+};
+
+queue_t *queue_create(unsigned long capacity)
+{
+    queue_t *queue;
+    size_t size = 2, j;
+
+    /* Past these the size would wrap around to 0, or the cells' size. */
+    if (capacity > SIZE_MAX/2+1)
+        return NULL;
+    while (size < capacity) size <<= 1;
+    if (size > SIZE_MAX/sizeof(queue_cell_t))
+        return NULL;
+    if ((queue = malloc(sizeof(*queue))) == NULL)
+        return NULL;
+    if ((queue->cells = malloc(sizeof(queue_cell_t)*size)) == NULL) {
+        free(queue);
+        return NULL;
+    }
+    for (j = 0; j < size; j++) {
+        atomic_init(&queue->cells[j].seq, j);
+        queue->cells[j].value = NULL;
+    }
+    queue->mask = size-1;
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    return queue;
+}
+
+void queue_free(queue_t *queue)
+{
+    free(queue->cells);
+    free(queue);
+}
+
+queue_t *queue_add(queue_t *queue, void *value)
+{
+    queue_cell_t *cell;
+    size_t pos, seq;
+    ptrdiff_t dif;
+
+    if (value == NULL) return NULL;
+    pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+        if (dif == 0) {
+            /* The cell is free: try to claim the position. */
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos,
+                    pos+1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            /* The consumer of the previous lap is not done: full. */
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    atomic_store_explicit(&cell->seq, pos+1, memory_order_release);
+    return queue;
+}
+
+void *queue_pop(queue_t *queue)
+{
+    queue_cell_t *cell;
+    size_t pos, seq;
+    ptrdiff_t dif;
+    void *value;
+
+    pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        dif = (ptrdiff_t)seq - (ptrdiff_t)(pos+1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos,
+                    pos+1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            /* No producer filled this cell yet: empty. */
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+    value = cell->value;
+    atomic_store_explicit(&cell->seq, pos + queue->mask + 1,
+                          memory_order_release);
+    return value;
+}
+
+unsigned long queue_size(queue_t *queue)
+{
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    return tail > head ? tail - head : 0;
+}
+
+unsigned long queue_capacity(queue_t *queue)
+{
+    return queue->mask + 1;
+}
@@ -0,0 +1,52 @@
+/* queue.h - A lock-free bounded multi-producer multi-consumer queue
+ *
+ * The queue is a ring of preallocated cells, each with a sequence number
+ * telling producers and consumers whose turn it is (Dmitry Vyukov's
+ * bounded MPMC queue). queue_add() and queue_pop() take no lock: every
+ * operation is one compare-and-swap on the shared position plus a store
+ * on the cell, so threads only contend on the positions. Cells are never
+ * freed while the queue is in use, so no memory reclamation scheme is
+ * needed, which is why the queue is bounded.
+ *
+ * It is meant to replace a list_t guarded by a mutex used as a work
+ * queue: queue_add() appends like list_add() and queue_pop() takes the
+ * value at the head.
+ */
+
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+/* The structure is private to queue.c, as it is made of C11 atomics. */
+typedef struct queue queue_t;
+
+/* Create a queue holding at most 'capacity' values, rounded up to the
+ * next power of two (and to at least 2).
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new queue. */
+queue_t *queue_create(unsigned long capacity);
+
+/* Free the queue. No other thread may be using it. The values still in
+ * the queue are not freed. */
+void queue_free(queue_t *queue);
+
+/* Add 'value' to the tail of the queue. This can be called by any
+ * number of threads at once.
+ *
+ * If the queue is full, or 'value' is NULL, NULL is returned and the
+ * queue remains unaltered. On success the 'queue' pointer is returned. */
+queue_t *queue_add(queue_t *queue, void *value);
+
+/* Remove and return the value at the head of the queue. This can be
+ * called by any number of threads at once.
+ *
+ * If the queue is empty NULL is returned. */
+void *queue_pop(queue_t *queue);
+
+/* Number of values in the queue. With concurrent producers or consumers
+ * this is only a snapshot. */
+unsigned long queue_size(queue_t *queue);
+
+/* Maximum number of values the queue can hold. */
+unsigned long queue_capacity(queue_t *queue);
+
+#endif /* __QUEUE_H__ */
@@ -0,0 +1,395 @@
+/* rcuhash.c - A chained hash map with wait-free lookups, in the RCU style
+ *
+ * See rcuhash.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "rcuhash.h"
+#include "strkey.h"
+
+#define RCUHASH_CACHE_LINE 64
+
+/* The size of a new map, and the number of retired elements and arrays
+ * after which a writer tries to free them. */
+#define RCUHASH_MIN_SIZE 16
+#define RCUHASH_RECLAIM_BATCH 64
+
+/* Elements are only written by the writer holding the lock, but read by
+ * lookups at any time, hence the atomics. 'retired' and 'epoch' are only
+ * used once the element is unlinked, by writers. */
+typedef struct rcuhash_node {
+    _Atomic(struct rcuhash_node*) next;
+    _Atomic(const char*) key;
+    _Atomic(void*) data;
+    uint64_t hash;
+    struct rcuhash_node *retired;
+    unsigned long epoch;
+} rcuhash_node_t;
+
+typedef struct rcuhash_table {
+    size_t mask;
+    struct rcuhash_table *retired;
+    unsigned long epoch;
+    _Atomic(rcuhash_node_t*) buckets[];
+} rcuhash_table_t;
+
+/* Lookups read 'table' and quiescent states read 'epoch', while writers
+ * update the rest at every operation: they live on separate lines. */
+struct rcuhash {
+    _Atomic(rcuhash_table_t*) table;
+    char pad0[RCUHASH_CACHE_LINE - sizeof(rcuhash_table_t*)];
+    atomic_ulong epoch;
+    char pad1[RCUHASH_CACHE_LINE - sizeof(atomic_ulong)];
+    pthread_mutex_t lock;
+    atomic_size_t count;
+    rcuhash_reader_t *readers;
+    rcuhash_node_t *retired_nodes;      /* newest first */
+    rcuhash_table_t *retired_tables;    /* newest first */
+    size_t retired;
+    size_t reclaim_at;          /* 'retired' at the next reclaim pass */
+    unsigned long reclaimed;    /* safe epoch of the last reclaim pass */
+};
+
+/* Every reader has a line of its own, written by its quiescent states and
+ * read by writers when they reclaim memory. */
+struct rcuhash_reader {
+    atomic_ulong seen;          /* epoch at the last quiescent state */
+    const rcuhash_t *map;
+    rcuhash_reader_t *next;
+    char pad[RCUHASH_CACHE_LINE - sizeof(atomic_ulong) -
+             sizeof(rcuhash_t*) - sizeof(rcuhash_reader_t*)];
+};
+
+static rcuhash_table_t *rcuhash_table_create(size_t size)
+{
+    rcuhash_table_t *table;
+    size_t j;
+
+    table = malloc(sizeof(*table) + sizeof(table->buckets[0])*size);
+    if (table == NULL) return NULL;
+    table->mask = size-1;
+    table->retired = NULL;
+    table->epoch = 0;
+    for (j = 0; j < size; j++) atomic_init(&table->buckets[j], NULL);
+    return table;
+}
+
+/* Free a bucket array along with the elements linked from it. */
+static void rcuhash_table_free(rcuhash_table_t *table)
+{
+    size_t j;
+
+    for (j = 0; j <= table->mask; j++) {
+        rcuhash_node_t *node = atomic_load_explicit(&table->buckets[j],
+                                                    memory_order_relaxed);
+        while (node) {
+            rcuhash_node_t *next = atomic_load_explicit(&node->next,
+                                                        memory_order_relaxed);
+            free(node);
+            node = next;
+        }
+    }
+    free(table);
+}
+
+rcuhash_t *rcuhash_create(void)
+{
+    rcuhash_t *map;
+    void *p;
+
+    if (posix_memalign(&p, RCUHASH_CACHE_LINE, sizeof(*map)) != 0)
+        return NULL;
+    map = p;
+    atomic_init(&map->table, rcuhash_table_create(RCUHASH_MIN_SIZE));
+    if (atomic_load_explicit(&map->table, memory_order_relaxed) == NULL) {
+        free(map);
+        return NULL;
+    }
+    atomic_init(&map->epoch, 1);
+    pthread_mutex_init(&map->lock, NULL);
+    atomic_init(&map->count, 0);
+    map->readers = NULL;
+    map->retired_nodes = NULL;
+    map->retired_tables = NULL;
+    map->retired = 0;
+    map->reclaim_at = RCUHASH_RECLAIM_BATCH;
+    map->reclaimed = 0;
+    return map;
+}
+
+/* Free the elements and arrays retired at or before 'epoch'. The lists
+ * are newest first, so everything from the first such one on goes. */
+static void rcuhash_free_retired(rcuhash_t *map, unsigned long epoch)
+{
+    rcuhash_node_t **pnode = &map->retired_nodes, *node;
+    rcuhash_table_t **ptable = &map->retired_tables, *table;
+
+    while (*pnode && (*pnode)->epoch > epoch) pnode = &(*pnode)->retired;
+    node = *pnode;
+    *pnode = NULL;
+    while (node) {
+        rcuhash_node_t *next = node->retired;
+        free(node);
+        map->retired--;
+        node = next;
+    }
+    while (*ptable && (*ptable)->epoch > epoch) ptable = &(*ptable)->retired;
+    table = *ptable;
+    *ptable = NULL;
+    while (table) {
+        rcuhash_table_t *next = table->retired;
+        rcuhash_table_free(table);
+        map->retired--;
+        table = next;
+    }
+}
+
+/* The oldest epoch a reader may still be using memory from: what was
+ * retired at or before it can be freed. Called with the lock held. */
+static unsigned long rcuhash_safe_epoch(rcuhash_t *map)
+{
+    unsigned long safe = atomic_load_explicit(&map->epoch,
+                                              memory_order_relaxed);
+    rcuhash_reader_t *reader;
+
+    for (reader = map->readers; reader; reader = reader->next) {
+        unsigned long seen = atomic_load_explicit(&reader->seen,
+                                                  memory_order_acquire);
+        if (seen < safe) safe = seen;
+    }
+    return safe;
+}
+
+/* Advance the epoch, so that the readers that see the new one can no
+ * longer reach what was just unlinked, and return it. */
+static unsigned long rcuhash_advance(rcuhash_t *map)
+{
+    return atomic_fetch_add_explicit(&map->epoch, 1, memory_order_seq_cst)+1;
+}
+
+/* Free what no reader can be using anymore. A reader that does not go
+ * through quiescent states keeps the safe epoch from moving: then the
+ * retired lists are not walked at all, and the next pass waits until
+ * the backlog doubled, so that a stalled reader costs the writers
+ * memory, at most twice what it holds, but no time. */
+static void rcuhash_reclaim(rcuhash_t *map)
+{
+    unsigned long safe = rcuhash_safe_epoch(map);
+
+    if (safe != map->reclaimed) {
+        rcuhash_free_retired(map, safe);
+        map->reclaimed = safe;
+    }
+    map->reclaim_at = map->retired + (map->retired > RCUHASH_RECLAIM_BATCH ?
+                                      map->retired : RCUHASH_RECLAIM_BATCH);
+}
+
+static void rcuhash_retire_node(rcuhash_t *map, rcuhash_node_t *node)
+{
+    node->epoch = rcuhash_advance(map);
+    node->retired = map->retired_nodes;
+    map->retired_nodes = node;
+    if (++map->retired >= map->reclaim_at)
+        rcuhash_reclaim(map);
+}
+
+static void rcuhash_retire_table(rcuhash_t *map, rcuhash_table_t *table)
+{
+    table->epoch = rcuhash_advance(map);
+    table->retired = map->retired_tables;
+    map->retired_tables = table;
+    map->retired++;
+    rcuhash_reclaim(map);
+}
+
+void rcuhash_free(rcuhash_t *map)
+{
+    rcuhash_free_retired(map, (unsigned long)-1);
+    rcuhash_table_free(atomic_load_explicit(&map->table,
+                                            memory_order_relaxed));
+    pthread_mutex_destroy(&map->lock);
+    free(map);
+}
+
+rcuhash_reader_t *rcuhash_register(rcuhash_t *map)
+{
+    rcuhash_reader_t *reader;
+    void *p;
+
+    if (posix_memalign(&p, RCUHASH_CACHE_LINE, sizeof(*reader)) != 0)
+        return NULL;
+    reader = p;
+    reader->map = map;
+    pthread_mutex_lock(&map->lock);
+    atomic_init(&reader->seen, atomic_load_explicit(&map->epoch,
+                                                    memory_order_relaxed));
+    reader->next = map->readers;
+    map->readers = reader;
+    pthread_mutex_unlock(&map->lock);
+    return reader;
+}
+
+void rcuhash_unregister(rcuhash_t *map, rcuhash_reader_t *reader)
+{
+    rcuhash_reader_t **prev;
+
+    pthread_mutex_lock(&map->lock);
+    for (prev = &map->readers; *prev != reader; prev = &(*prev)->next);
+    *prev = reader->next;
+    pthread_mutex_unlock(&map->lock);
+    free(reader);
+}
+
+/* The acquire load of the epoch makes the unlinks that preceded it
+ * visible to the next lookups, and the release store keeps the loads of
+ * the previous lookups before it, so a writer that sees the new value
+ * knows they are over. */
+void rcuhash_quiescent(rcuhash_reader_t *reader)
+{
+    unsigned long epoch = atomic_load_explicit(&reader->map->epoch,
+                                               memory_order_acquire);
+
+    if (atomic_load_explicit(&reader->seen, memory_order_relaxed) != epoch)
+        atomic_store_explicit(&reader->seen, epoch, memory_order_release);
+}
+
+void *rcuhash_find(const rcuhash_t *map, const char *key)
+{
+    uint64_t hash = strkey_hash(key);
+    rcuhash_table_t *table;
+    rcuhash_node_t *node;
+
+    table = atomic_load_explicit(&map->table, memory_order_acquire);
+    node = atomic_load_explicit(&table->buckets[hash & table->mask],
+                                memory_order_acquire);
+    while (node) {
+        if (node->hash == hash &&
+            strkey_equal(atomic_load_explicit(&node->key,
+                                                   memory_order_acquire), key))
+            return atomic_load_explicit(&node->data, memory_order_acquire);
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    }
+    return NULL;
+}
+
+/* Build a bucket array of 'size' buckets with copies of the elements of
+ * the current one, publish it and retire the old one. Lookups still
+ * walking the old array find the same keys there. If memory runs out
+ * the map keeps its current array. Called with the lock held. */
+static void rcuhash_resize(rcuhash_t *map, size_t size)
+{
+    rcuhash_table_t *old = atomic_load_explicit(&map->table,
+                                                memory_order_relaxed);
+    rcuhash_table_t *table = rcuhash_table_create(size);
+    size_t j;
+
+    if (table == NULL) return;
+    for (j = 0; j <= old->mask; j++) {
+        rcuhash_node_t *node = atomic_load_explicit(&old->buckets[j],
+                                                    memory_order_relaxed);
+        for (; node; node = atomic_load_explicit(&node->next,
+                                                 memory_order_relaxed)) {
+            rcuhash_node_t *copy = malloc(sizeof(*copy));
+            size_t i = node->hash & table->mask;
+
+            if (copy == NULL) {
+                rcuhash_table_free(table);
+                return;
+            }
+            *copy = *node;
+            atomic_init(&copy->next, atomic_load_explicit(&table->buckets[i],
+                        memory_order_relaxed));
+            atomic_init(&table->buckets[i], copy);
+        }
+    }
+    atomic_store_explicit(&map->table, table, memory_order_release);
+    rcuhash_retire_table(map, old);
+}
+
+void *rcuhash_insert(rcuhash_t *map, const char *key, void *data)
+{
+    uint64_t hash = strkey_hash(key);
+    _Atomic(rcuhash_node_t*) *link;
+    rcuhash_table_t *table;
+    rcuhash_node_t *node;
+    size_t count;
+    void *old;
+
+    pthread_mutex_lock(&map->lock);
+    table = atomic_load_explicit(&map->table, memory_order_relaxed);
+    link = &table->buckets[hash & table->mask];
+    while ((node = atomic_load_explicit(link, memory_order_relaxed)) != NULL) {
+        if (node->hash == hash &&
+            strkey_equal(atomic_load_explicit(&node->key,
+                                                   memory_order_relaxed), key))
+            break;
+        link = &node->next;
+    }
+    if (node) {
+        old = atomic_load_explicit(&node->data, memory_order_relaxed);
+        if (data == NULL) {
+            /* Unlink; lookups standing on the node can still go on. */
+            atomic_store_explicit(link, atomic_load_explicit(&node->next,
+                                  memory_order_relaxed), memory_order_release);
+            atomic_fetch_sub_explicit(&map->count, 1, memory_order_relaxed);
+            rcuhash_retire_node(map, node);
+        } else {
+            atomic_store_explicit(&node->key, key, memory_order_release);
+            atomic_store_explicit(&node->data, data, memory_order_release);
+        }
+        pthread_mutex_unlock(&map->lock);
+        return old;
+    }
+    if (data == NULL || (node = malloc(sizeof(*node))) == NULL) {
+        pthread_mutex_unlock(&map->lock);
+        return data;
+    }
+    atomic_init(&node->key, key);
+    atomic_init(&node->data, data);
+    node->hash = hash;
+    node->retired = NULL;
+    node->epoch = 0;
+    link = &table->buckets[hash & table->mask];
+    atomic_init(&node->next, atomic_load_explicit(link, memory_order_relaxed));
+    atomic_store_explicit(link, node, memory_order_release);
+    /* Grow as Hash does: past two keys per bucket, to 2 buckets per key
+     * rounded down to a power of two. */
+    count = atomic_fetch_add_explicit(&map->count, 1, memory_order_relaxed)+1;
+    if (count > 2*(table->mask+1)) {
+        size_t size = table->mask+1;
+
+        while (size <= count) size <<= 1;
+        rcuhash_resize(map, size);
+    }
+    pthread_mutex_unlock(&map->lock);
+    return NULL;
+}
+
+void rcuhash_synchronize(rcuhash_t *map)
+{
+    unsigned long epoch;
+
+    pthread_mutex_lock(&map->lock);
+    epoch = rcuhash_advance(map);
+    pthread_mutex_unlock(&map->lock);
+    while (1) {
+        pthread_mutex_lock(&map->lock);
+        if (rcuhash_safe_epoch(map) >= epoch) {
+            rcuhash_free_retired(map, epoch);
+            pthread_mutex_unlock(&map->lock);
+            return;
+        }
+        pthread_mutex_unlock(&map->lock);
+        sched_yield();
+    }
+}
+
+size_t rcuhash_size(const rcuhash_t *map)
+{
+    return atomic_load_explicit(&map->count, memory_order_relaxed);
+}
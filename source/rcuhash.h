@@ -0,0 +1,90 @@
+/* rcuhash.h - A chained hash map with wait-free lookups, in the RCU style
+ *
+ * Lookups take no lock and perform no atomic read-modify-write: they load
+ * the bucket array and follow the chain with plain (acquire) loads, so
+ * they never write to memory shared with other threads and never wait.
+ * Writers are serialized by a mutex. They publish new elements with a
+ * single store of the bucket head, unlink removed ones with a single
+ * store of the previous link, and grow the map by building a complete
+ * new bucket array, with copies of the elements, and publishing it with
+ * one store. A lookup thus always sees either the old or the new state.
+ *
+ * Removed elements and replaced bucket arrays can still be in use by a
+ * lookup, so they are freed with quiescent state based reclamation:
+ * every thread calling rcuhash_find() registers as a reader and calls
+ * rcuhash_quiescent() from time to time, at a point where it holds no
+ * pointer into the map (between requests, for example). Each removal
+ * advances a global epoch, and memory retired at some epoch is freed by
+ * the writers once every reader went through a quiescent state after
+ * it. A reader that stops calling rcuhash_quiescent() without
+ * unregistering keeps retired memory from being freed, but never blocks
+ * or slows down a writer.
+ *
+ * Keys are NUL-terminated strings, and they are not copied. They compare
+ * without regard to ASCII case, like the default key class of Hash,
+ * although they are hashed differently (see strkey.h). A key removed
+ * from the map may still be read by lookups until the readers go through
+ * a quiescent state, so it must not be freed before that either:
+ * rcuhash_synchronize() waits for it.
+ */
+
+#ifndef __RCUHASH_H__
+#define __RCUHASH_H__
+
+#include <stddef.h>
+
+/* The structures are private to rcuhash.c, as they are made of C11
+ * atomics. */
+typedef struct rcuhash rcuhash_t;
+typedef struct rcuhash_reader rcuhash_reader_t;
+
+/* Create a new empty map.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new map. */
+rcuhash_t *rcuhash_create(void);
+
+/* Free the map. No other thread may be using it and every reader must
+ * have been unregistered. Keys and data are not freed. */
+void rcuhash_free(rcuhash_t *map);
+
+/* Register the calling thread as a reader of the map. The reader starts
+ * in a quiescent state.
+ *
+ * On error, NULL is returned. Otherwise the handle of the reader. */
+rcuhash_reader_t *rcuhash_register(rcuhash_t *map);
+
+/* Unregister a reader. It must not use the map afterwards, unless it
+ * registers again. */
+void rcuhash_unregister(rcuhash_t *map, rcuhash_reader_t *reader);
+
+/* Tell that the reader holds no pointer obtained from the map anymore:
+ * elements removed before this point can be freed. This is one load and
+ * one store, both to lines the writers rarely touch. */
+void rcuhash_quiescent(rcuhash_reader_t *reader);
+
+/* Return the data associated with 'key', or NULL if it is not in the
+ * map. Any number of registered readers may call this at once,
+ * concurrently with a writer; other threads only when no writer runs.
+ * The data stays readable until the next rcuhash_quiescent() of the
+ * reader even if the key is removed. */
+void *rcuhash_find(const rcuhash_t *map, const char *key);
+
+/* Associate 'data' with 'key', or remove the key if 'data' is NULL, like
+ * sqlite3HashInsert(): the previous data of the key is returned, or
+ * NULL if it was not in the map. If memory runs out, 'data' is returned
+ * and the map is unchanged. Writers take a mutex, so any thread may call
+ * this, registered or not. */
+void *rcuhash_insert(rcuhash_t *map, const char *key, void *data);
+
+/* Wait until every registered reader went through a quiescent state,
+ * then free all the retired memory. After it returns, keys and data
+ * removed before the call are no longer referenced by the map or its
+ * readers. It must not be called by a registered reader, which would
+ * wait for itself. */
+void rcuhash_synchronize(rcuhash_t *map);
+
+/* Number of keys in the map. With a concurrent writer this is only a
+ * snapshot. */
+size_t rcuhash_size(const rcuhash_t *map);
+
+#endif /* __RCUHASH_H__ */
@@ -0,0 +1,124 @@
+/* shardmap.c - A hash map for concurrent use, sharded over locked Hash tables
+ *
+ * See shardmap.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "hash.h"
+#include "shardmap.h"
+
+#define SHARDMAP_CACHE_LINE 64
+
+typedef struct shardmap_shard {
+    pthread_rwlock_t lock;
+    Hash hash;
+} shardmap_shard_t;
+
+/* Shards are padded to a whole number of cache lines, so that taking the
+ * lock of one shard does not invalidate the line of its neighbours. */
+typedef union shardmap_slot {
+    shardmap_shard_t shard;
+    char pad[(sizeof(shardmap_shard_t)+SHARDMAP_CACHE_LINE-1) /
+             SHARDMAP_CACHE_LINE*SHARDMAP_CACHE_LINE];
+} shardmap_slot_t;
+
+struct shardmap {
+    shardmap_slot_t *slots;
+    unsigned int mask;
+};
+
+shardmap_t *shardmap_create(unsigned int shards)
+{
+    shardmap_t *map;
+    void *slots;
+    unsigned int size = 1, j;
+
+    /* Past these the size would wrap around to 0, or the slots' size. */
+    if (shards > UINT_MAX/2+1)
+        return NULL;
+    while (size < shards) size <<= 1;
+    if (sizeof(shardmap_slot_t)*(size_t)size/sizeof(shardmap_slot_t) != size)
+        return NULL;
+    if ((map = malloc(sizeof(*map))) == NULL)
+        return NULL;
+    if (posix_memalign(&slots, SHARDMAP_CACHE_LINE,
+                       sizeof(shardmap_slot_t)*size) != 0) {
+        free(map);
+        return NULL;
+    }
+    map->slots = slots;
+    map->mask = size-1;
+    for (j = 0; j < size; j++) {
+        pthread_rwlock_init(&map->slots[j].shard.lock, NULL);
+        sqlite3HashInit(&map->slots[j].shard.hash);
+    }
+    return map;
+}
+
+void shardmap_free(shardmap_t *map)
+{
+    unsigned int j;
+
+    for (j = 0; j <= map->mask; j++) {
+        sqlite3HashClear(&map->slots[j].shard.hash);
+        pthread_rwlock_destroy(&map->slots[j].shard.lock);
+    }
+    free(map->slots);
+    free(map);
+}
+
+/* The shard of a key is picked with the low bits of the hash the tables
+ * compute for it; Hash picks buckets with the high bits of the hash
+ * multiplied by a constant, so within a shard the keys still spread
+ * over all the buckets. The key class is the same for every shard and
+ * never changes, so the first table can hash for all of them without a
+ * lock. */
+static shardmap_shard_t *shardmap_shard(shardmap_t *map, const char *key,
+                                        int nkey)
+{
+    unsigned int h = sqlite3HashKeyHash(&map->slots[0].shard.hash, key, nkey);
+
+    return &map->slots[h & map->mask].shard;
+}
+
+void *shardmap_insert(shardmap_t *map, const char *key, void *data)
+{
+    int nkey = (int)strlen(key);
+    shardmap_shard_t *shard = shardmap_shard(map, key, nkey);
+    void *old;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    old = sqlite3HashInsertKey(&shard->hash, key, nkey, data);
+    pthread_rwlock_unlock(&shard->lock);
+    return old;
+}
+
+void *shardmap_find(shardmap_t *map, const char *key)
+{
+    int nkey = (int)strlen(key);
+    shardmap_shard_t *shard = shardmap_shard(map, key, nkey);
+    void *data;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    data = sqlite3HashFindKey(&shard->hash, key, nkey);
+    pthread_rwlock_unlock(&shard->lock);
+    return data;
+}
+
+unsigned long shardmap_size(shardmap_t *map)
+{
+    unsigned long size = 0;
+    unsigned int j;
+
+    for (j = 0; j <= map->mask; j++) {
+        shardmap_shard_t *shard = &map->slots[j].shard;
+
+        pthread_rwlock_rdlock(&shard->lock);
+        size += shard->hash.count;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return size;
+}
@@ -0,0 +1,53 @@
+/* shardmap.h - A hash map for concurrent use, sharded over locked Hash tables
+ *
+ * Keys are spread over a power of two number of shards by their hash,
+ * and every shard is a Hash (see hash.h) with its own reader-writer
+ * lock, on its own cache lines. Lookups take the lock of their shard in
+ * shared mode, which Hash allows as its lookups never modify the table,
+ * and inserts and deletes take it exclusively. Threads working on
+ * different shards never wait for each other, so with enough shards a
+ * write-heavy workload scales with the number of threads instead of
+ * serializing on one mutex. Lookups on the same shard still write to the
+ * shared lock word, so a read-mostly workload pays one contended atomic
+ * per lookup.
+ *
+ * Keys follow the default class of Hash: NUL-terminated strings
+ * compared without regard to ASCII case. They are not copied, so they
+ * must stay valid for as long as they are in the map.
+ */
+
+#ifndef __SHARDMAP_H__
+#define __SHARDMAP_H__
+
+/* The structure is private to shardmap.c, as it is made of locks. */
+typedef struct shardmap shardmap_t;
+
+/* Create a map of 'shards' shards, rounded up to the next power of two
+ * (and to at least 1). A few times the number of threads using the map
+ * keeps the odds of two of them wanting the same shard low.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new map. */
+shardmap_t *shardmap_create(unsigned int shards);
+
+/* Free the map. No other thread may be using it. Keys and data are not
+ * freed. */
+void shardmap_free(shardmap_t *map);
+
+/* Associate 'data' with 'key', or remove the key if 'data' is NULL,
+ * like sqlite3HashInsert(): the previous data of the key is returned,
+ * or NULL if it was not in the map. If memory runs out, 'data' is
+ * returned and the map is unchanged. This can be called by any number
+ * of threads at once. */
+void *shardmap_insert(shardmap_t *map, const char *key, void *data);
+
+/* Return the data associated with 'key', or NULL if it is not in the
+ * map. This can be called by any number of threads at once. The data is
+ * returned after the shard is unlocked: keeping it valid while it is
+ * used is up to the caller. */
+void *shardmap_find(shardmap_t *map, const char *key);
+
+/* Number of keys in the map. With concurrent writers this is only a
+ * snapshot. */
+unsigned long shardmap_size(shardmap_t *map);
+
+#endif /* __SHARDMAP_H__ */
@@ -0,0 +1,49 @@
+/* strkey.h - Hashing and comparison of case insensitive string keys
+ *
+ * swiss_t and rcuhash_t both take NUL-terminated string keys compared
+ * without regard to ASCII case, like the default key class of Hash. They
+ * share the helpers below so that they can't drift apart. The hash is
+ * not the one of Hash: FNV-1a over the case folded key, finished with
+ * the MurmurHash3 mixer, gives 64 bits that all depend on every byte of
+ * the key, as swiss.c splits them between the slot index and the
+ * control byte.
+ */
+
+#ifndef __STRKEY_H__
+#define __STRKEY_H__
+
+#include <stdint.h>
+
+static inline unsigned char strkey_fold(unsigned char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static inline uint64_t strkey_hash(const char *key)
+{
+    const unsigned char *p = (const unsigned char*)key;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*p) {
+        h ^= strkey_fold(*p++);
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline int strkey_equal(const char *a, const char *b)
+{
+    if (a == b) return 1;
+    while (*a && strkey_fold(*a) == strkey_fold(*b)) {
+        a++;
+        b++;
+    }
+    return strkey_fold(*a) == strkey_fold(*b);
+}
+
+#endif /* __STRKEY_H__ */
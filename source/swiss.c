@@ -0,0 +1,346 @@
+/* swiss.c - An open addressing hash map probed a group of slots at a time
+ *
+ * See swiss.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "swiss.h"
+#include "strkey.h"
+
+/* Groups are 16 control bytes compared with one SSE2 instruction, or 8
+ * bytes compared with word arithmetic where SSE2 is not available (or
+ * SWISS_NO_SIMD is defined). Wider AVX2 groups are not used: a 16 byte
+ * group already ends almost every probe, and 32 byte loads would cross
+ * cache lines twice as often. */
+#if defined(__SSE2__) && !defined(SWISS_NO_SIMD)
+#include <emmintrin.h>
+#define SWISS_SSE2 1
+#define SWISS_GROUP_WIDTH 16
+#else
+#define SWISS_GROUP_WIDTH 8
+#endif
+
+/* Control bytes. Full slots hold the 7 low bits of their hash, so they
+ * are the only non negative ones, and empty slots are the only ones with
+ * the sign bit set and the next bit clear. */
+#define SWISS_EMPTY ((signed char)-128)     /* 0b10000000 */
+#define SWISS_DELETED ((signed char)-2)     /* 0b11111110 */
+
+/* The smallest table: a power of two of at least one group. */
+#define SWISS_MIN_CAPACITY 16
+
+/* Maps without slots point to this group, so that lookups need no
+ * special case: it is never written. */
+static const signed char swiss_empty_group[16] = {
+    SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY,
+    SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY,
+    SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY,
+    SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY, SWISS_EMPTY
+};
+
+#if defined(__GNUC__)
+#define swiss_ctz(x) __builtin_ctzll(x)
+#define swiss_clz(x) __builtin_clzll(x)
+#else
+static int swiss_ctz(uint64_t x)
+{
+    int n = 0;
+    while (!(x & 1)) { x >>= 1; n++; }
+    return n;
+}
+
+static int swiss_clz(uint64_t x)
+{
+    int n = 0;
+    while (!(x & ((uint64_t)1 << 63))) { x <<= 1; n++; }
+    return n;
+}
+#endif
+
+/* A group match is a bit mask with 1<<SWISS_MASK_SHIFT bits per slot of
+ * the group, the lowest ones standing for the first slot. */
+#ifdef SWISS_SSE2
+typedef __m128i swiss_group_t;
+#define SWISS_MASK_SHIFT 0
+
+static swiss_group_t swiss_load(const signed char *ctrl)
+{
+    return _mm_loadu_si128((const __m128i*)ctrl);
+}
+
+static uint64_t swiss_match(swiss_group_t g, signed char h2)
+{
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), g));
+}
+
+static uint64_t swiss_match_empty(swiss_group_t g)
+{
+    return swiss_match(g, SWISS_EMPTY);
+}
+
+static uint64_t swiss_match_empty_or_deleted(swiss_group_t g)
+{
+    return (unsigned)_mm_movemask_epi8(g);
+}
+#else
+typedef uint64_t swiss_group_t;
+#define SWISS_MASK_SHIFT 3
+#define SWISS_LSBS 0x0101010101010101ULL
+#define SWISS_MSBS 0x8080808080808080ULL
+
+/* The first control byte goes to the low byte of the word. */
+static swiss_group_t swiss_load(const signed char *ctrl)
+{
+    uint64_t g;
+
+    memcpy(&g, ctrl, sizeof(g));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    g = __builtin_bswap64(g);
+#endif
+    return g;
+}
+
+/* Bytes equal to h2 get their high bit set. This can report a false
+ * match for a byte right above a real one, which only costs a key
+ * comparison. */
+static uint64_t swiss_match(swiss_group_t g, signed char h2)
+{
+    uint64_t x = g ^ (SWISS_LSBS * (unsigned char)h2);
+    return (x - SWISS_LSBS) & ~x & SWISS_MSBS;
+}
+
+static uint64_t swiss_match_empty(swiss_group_t g)
+{
+    return g & (~g << 6) & SWISS_MSBS;
+}
+
+static uint64_t swiss_match_empty_or_deleted(swiss_group_t g)
+{
+    return g & SWISS_MSBS;
+}
+#endif
+
+/* Index of the first slot of a match, and number of slots after the
+ * last one. */
+#define swiss_mask_first(m) (swiss_ctz(m) >> SWISS_MASK_SHIFT)
+#ifdef SWISS_SSE2
+#define swiss_mask_leading(m) (swiss_clz(m) - (64 - SWISS_GROUP_WIDTH))
+#else
+#define swiss_mask_leading(m) (swiss_clz(m) >> SWISS_MASK_SHIFT)
+#endif
+
+/* The 7 low bits of the hash of a key make its control byte and the
+ * others pick its group, see strkey.h. */
+#define swiss_h1(hash) ((size_t)((hash) >> 7))
+#define swiss_h2(hash) ((signed char)((hash) & 0x7f))
+
+#define swiss_capacity(s) ((s)->slots ? (s)->mask+1 : 0)
+
+/* Set a control byte, and its clone past the end if it is in the first
+ * group, so that a group loaded near the end wraps around. */
+static void swiss_set_ctrl(swiss_t *map, size_t i, signed char c)
+{
+    map->ctrl[i] = c;
+    if (i < SWISS_GROUP_WIDTH)
+        map->ctrl[map->mask+1+i] = c;
+}
+
+/* Groups are probed in triangular steps, which visits every group of a
+ * power of two table. The probe for a key ends at the first group with
+ * an empty slot, since an insert would have stopped there. */
+static size_t swiss_find_index(const swiss_t *map, const char *key,
+                               uint64_t hash)
+{
+    signed char h2 = swiss_h2(hash);
+    size_t pos = swiss_h1(hash) & map->mask, step = 0;
+    swiss_group_t g;
+    uint64_t m;
+
+    for (;;) {
+        g = swiss_load(map->ctrl + pos);
+        for (m = swiss_match(g, h2); m; m &= m-1) {
+            size_t i = (pos + swiss_mask_first(m)) & map->mask;
+            if (strkey_equal(map->slots[i].key, key))
+                return i;
+        }
+        if (swiss_match_empty(g))
+            return (size_t)-1;
+        step += SWISS_GROUP_WIDTH;
+        pos = (pos + step) & map->mask;
+    }
+}
+
+/* Return the first empty or deleted slot of the probe sequence of 'hash'.
+ * There is always one, as the map is never allowed to fill up. */
+static size_t swiss_find_free(const swiss_t *map, uint64_t hash)
+{
+    size_t pos = swiss_h1(hash) & map->mask, step = 0;
+    uint64_t m;
+
+    for (;;) {
+        m = swiss_match_empty_or_deleted(swiss_load(map->ctrl + pos));
+        if (m)
+            return (pos + swiss_mask_first(m)) & map->mask;
+        step += SWISS_GROUP_WIDTH;
+        pos = (pos + step) & map->mask;
+    }
+}
+
+/* At most 7/8 of the slots are used, counting deleted ones. */
+#define swiss_max_load(capacity) ((capacity) - (capacity)/8)
+
+/* Move every key to a new table of 'capacity' slots, which also drops
+ * the deleted slots. Returns 0 if the allocation fails. */
+static int swiss_resize(swiss_t *map, size_t capacity)
+{
+    swiss_slot_t *slots;
+    signed char *ctrl;
+    size_t old_capacity = swiss_capacity(map), i, j;
+    swiss_t old = *map;
+    uint64_t hash;
+
+    slots = malloc(sizeof(swiss_slot_t)*capacity +
+                   capacity + SWISS_GROUP_WIDTH);
+    if (slots == NULL)
+        return 0;
+    ctrl = (signed char*)(slots + capacity);
+    memset(ctrl, SWISS_EMPTY, capacity + SWISS_GROUP_WIDTH);
+    map->slots = slots;
+    map->ctrl = ctrl;
+    map->mask = capacity-1;
+    map->growth_left = swiss_max_load(capacity) - map->count;
+    for (j = 0; j < old_capacity; j++) {
+        if (old.ctrl[j] < 0) continue;
+        hash = strkey_hash(old.slots[j].key);
+        i = swiss_find_free(map, hash);
+        swiss_set_ctrl(map, i, swiss_h2(hash));
+        map->slots[i] = old.slots[j];
+    }
+    free(old.slots);
+    return 1;
+}
+
+swiss_t *swiss_create(void)
+{
+    swiss_t *map;
+
+    if ((map = malloc(sizeof(*map))) == NULL)
+        return NULL;
+    map->slots = NULL;
+    swiss_clear(map);
+    return map;
+}
+
+void swiss_clear(swiss_t *map)
+{
+    free(map->slots);
+    map->slots = NULL;
+    map->ctrl = (signed char*)swiss_empty_group;
+    map->mask = 0;
+    map->count = 0;
+    map->growth_left = 0;
+}
+
+void swiss_free(swiss_t *map)
+{
+    free(map->slots);
+    free(map);
+}
+
+void *swiss_find(const swiss_t *map, const char *key)
+{
+    size_t i;
+
+    if (map->count == 0)
+        return NULL;
+    i = swiss_find_index(map, key, strkey_hash(key));
+    return i == (size_t)-1 ? NULL : map->slots[i].data;
+}
+
+void *swiss_insert(swiss_t *map, const char *key, void *data)
+{
+    uint64_t hash;
+    size_t i, capacity;
+
+    if (data == NULL)
+        return swiss_delete(map, key);
+    hash = strkey_hash(key);
+    if (map->count && (i = swiss_find_index(map, key, hash)) != (size_t)-1) {
+        void *old = map->slots[i].data;
+        map->slots[i].key = key;
+        map->slots[i].data = data;
+        return old;
+    }
+    capacity = swiss_capacity(map);
+    i = capacity ? swiss_find_free(map, hash) : 0;
+    if (capacity == 0 || (map->growth_left == 0 && map->ctrl[i] == SWISS_EMPTY)) {
+        /* Out of empty slots: grow, unless deleted slots make up for
+         * more than half of the used ones, in which case dropping them
+         * is enough. */
+        if (capacity == 0)
+            capacity = SWISS_MIN_CAPACITY;
+        else if (map->count > swiss_max_load(capacity)/2)
+            capacity *= 2;
+        if (!swiss_resize(map, capacity))
+            return data;
+        i = swiss_find_free(map, hash);
+    }
+    if (map->ctrl[i] == SWISS_EMPTY)
+        map->growth_left--;
+    swiss_set_ctrl(map, i, swiss_h2(hash));
+    map->slots[i].key = key;
+    map->slots[i].data = data;
+    map->count++;
+    return NULL;
+}
+
+void *swiss_delete(swiss_t *map, const char *key)
+{
+    size_t i, before;
+    uint64_t empty_before, empty_after;
+    void *data;
+
+    if (map->count == 0)
+        return NULL;
+    if ((i = swiss_find_index(map, key, strkey_hash(key))) == (size_t)-1)
+        return NULL;
+    data = map->slots[i].data;
+    map->count--;
+
+    /* If no group holding slot i was ever full, no probe went past it
+     * and the slot can be empty again. Otherwise it must stay deleted,
+     * so that such probes do not stop there. */
+    before = (i - SWISS_GROUP_WIDTH) & map->mask;
+    empty_before = swiss_match_empty(swiss_load(map->ctrl + before));
+    empty_after = swiss_match_empty(swiss_load(map->ctrl + i));
+    if (empty_before && empty_after &&
+        swiss_mask_first(empty_after) + swiss_mask_leading(empty_before)
+            < SWISS_GROUP_WIDTH) {
+        swiss_set_ctrl(map, i, SWISS_EMPTY);
+        map->growth_left++;
+    } else {
+        swiss_set_ctrl(map, i, SWISS_DELETED);
+    }
+    return data;
+}
+
+void swiss_rewind(const swiss_t *map, swiss_iter_t *iter)
+{
+    iter->map = map;
+    iter->pos = 0;
+}
+
+swiss_slot_t *swiss_next(swiss_iter_t *iter)
+{
+    const swiss_t *map = iter->map;
+    size_t capacity = swiss_capacity(map);
+
+    while (iter->pos < capacity) {
+        size_t i = iter->pos++;
+        if (map->ctrl[i] >= 0)
+            return &map->slots[i];
+    }
+    return NULL;
+}
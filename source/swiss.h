@@ -0,0 +1,90 @@
+/* swiss.h - An open addressing hash map probed a group of slots at a time
+ *
+ * The map follows the layout of Abseil's SwissTable: slots live in one
+ * flat array, and a parallel array holds one control byte per slot,
+ * telling whether the slot is empty, deleted, or full, and in the last
+ * case 7 bits of the hash of its key. A lookup loads a whole group of 16
+ * control bytes (8 without SSE2) and compares them with the 7 bits of the
+ * key hash at once, so only slots whose bits match are compared with the
+ * key, and a group with an empty slot ends the probe. Most lookups touch
+ * one cache line of control bytes and one slot, where the chained Hash
+ * follows a pointer per element of the bucket.
+ *
+ * The interface mirrors hash.h: keys are NUL-terminated strings compared
+ * without regard to ASCII case, and they are not copied, so they must
+ * stay valid for as long as they are in the map. swiss_insert() behaves
+ * like sqlite3HashInsert() and swiss_find() like sqlite3HashFind().
+ */
+
+#ifndef __SWISS_H__
+#define __SWISS_H__
+
+#include <stddef.h>
+
+typedef struct swiss_slot {
+    const char *key;
+    void *data;
+} swiss_slot_t;
+
+typedef struct swiss {
+    signed char *ctrl;      /* capacity control bytes, plus a group cloned */
+    swiss_slot_t *slots;    /* capacity slots */
+    size_t mask;            /* capacity-1, capacity being a power of two */
+    size_t count;           /* number of keys in the map */
+    size_t growth_left;     /* empty slots left before the map must grow */
+} swiss_t;
+
+typedef struct swiss_iter {
+    const swiss_t *map;
+    size_t pos;
+} swiss_iter_t;
+
+/* Functions implemented as macros */
+#define swiss_size(s) ((s)->count)
+
+/* Walk the map with an iterator in caller provided storage:
+ *
+ * swiss_foreach(map, iter, slot) {
+ *     doSomethingWith(slot->key, slot->data);
+ * }
+ */
+#define swiss_foreach(s,iter,slot) \
+    for (swiss_rewind((s), &(iter)); ((slot) = swiss_next(&(iter))) != NULL; )
+
+/* Prototypes */
+/* Create a new empty map. No memory is allocated for slots until the
+ * first insert.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new map. */
+swiss_t *swiss_create(void);
+
+/* Free the map. Keys and data are not freed. */
+void swiss_free(swiss_t *map);
+
+/* Remove every key from the map and release its slots. */
+void swiss_clear(swiss_t *map);
+
+/* Associate 'data' with 'key'. If the key was already in the map its
+ * previous data is returned, otherwise NULL is returned. If 'data' is
+ * NULL the key is removed. If the map needs to grow and the allocation
+ * fails, 'data' is returned and the map is unchanged. */
+void *swiss_insert(swiss_t *map, const char *key, void *data);
+
+/* Return the data associated with 'key', or NULL if it is not in the
+ * map. */
+void *swiss_find(const swiss_t *map, const char *key);
+
+/* Remove 'key' from the map and return its data, or NULL if it was not
+ * in the map. The slots are not moved: removing the key returned last by
+ * swiss_next() does not disturb the iteration. */
+void *swiss_delete(swiss_t *map, const char *key);
+
+/* Initialize an iterator in caller provided storage. */
+void swiss_rewind(const swiss_t *map, swiss_iter_t *iter);
+
+/* Return the next slot of the iteration, or NULL when there are no more.
+ * The order is unspecified. The map must not be inserted into while it
+ * is iterated. */
+swiss_slot_t *swiss_next(swiss_iter_t *iter);
+
+#endif /* __SWISS_H__ */
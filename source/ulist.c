@@ -0,0 +1,247 @@
+/* ulist.c - An unrolled doubly linked list of pointers
+ *
+ * See ulist.h for the description of the data structure.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ulist.h"
+
+static ulist_node_t *ulist_node_create(void)
+{
+    ulist_node_t *node;
+
+    if ((node = malloc(sizeof(*node))) == NULL)
+        return NULL;
+    node->prev = node->next = NULL;
+    node->count = 0;
+    return node;
+}
+
+/* Unlink an empty node from the list and release it. */
+static void ulist_node_delete(ulist_t *list, ulist_node_t *node)
+{
+    if (node->prev)
+        node->prev->next = node->next;
+    else
+        list->head = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    else
+        list->tail = node->prev;
+    free(node);
+    list->nodes--;
+}
+
+/* Remove the value at 'offset' of 'node', releasing the node if it
+ * becomes empty. The value itself is not freed. */
+static void ulist_node_remove(ulist_t *list, ulist_node_t *node, long offset)
+{
+    node->count--;
+    memmove(&node->values[offset], &node->values[offset+1],
+            (node->count-offset)*sizeof(void*));
+    list->len--;
+    if (node->count == 0)
+        ulist_node_delete(list, node);
+}
+
+ulist_t *ulist_create(void)
+{
+    ulist_t *list;
+
+    if ((list = malloc(sizeof(*list))) == NULL)
+        return NULL;
+    list->head = list->tail = NULL;
+    list->free = NULL;
+    list->match = NULL;
+    list->len = 0;
+    list->nodes = 0;
+    return list;
+}
+
+void ulist_free(ulist_t *list)
+{
+    ulist_node_t *current, *next;
+    unsigned int j;
+
+    current = list->head;
+    while(current) {
+        next = current->next;
+        if (list->free) {
+            for (j = 0; j < current->count; j++)
+                list->free(current->values[j]);
+        }
+        free(current);
+        current = next;
+    }
+    free(list);
+}
+
+ulist_t *ulist_add_head(ulist_t *list, void *value)
+{
+    ulist_node_t *node = list->head;
+
+    if (node == NULL || node->count == ULIST_NODE_FILL) {
+        if ((node = ulist_node_create()) == NULL)
+            return NULL;
+        node->next = list->head;
+        if (list->head)
+            list->head->prev = node;
+        else
+            list->tail = node;
+        list->head = node;
+        list->nodes++;
+    } else {
+        memmove(&node->values[1], &node->values[0],
+                node->count*sizeof(void*));
+    }
+    node->values[0] = value;
+    node->count++;
+    list->len++;
+    return list;
+}
+
+ulist_t *ulist_add(ulist_t *list, void *value)
+{
+    ulist_node_t *node = list->tail;
+
+    if (node == NULL || node->count == ULIST_NODE_FILL) {
+        if ((node = ulist_node_create()) == NULL)
+            return NULL;
+        node->prev = list->tail;
+        if (list->tail)
+            list->tail->next = node;
+        else
+            list->head = node;
+        list->tail = node;
+        list->nodes++;
+    }
+    node->values[node->count++] = value;
+    list->len++;
+    return list;
+}
+
+int ulist_pop(ulist_t *list, int where, void **value)
+{
+    ulist_node_t *node;
+
+    if (list->len == 0) return 0;
+    if (where == ULIST_HEAD) {
+        node = list->head;
+        *value = node->values[0];
+        ulist_node_remove(list, node, 0);
+    } else {
+        node = list->tail;
+        *value = node->values[node->count-1];
+        ulist_node_remove(list, node, node->count-1);
+    }
+    return 1;
+}
+
+void **ulist_index(ulist_t *list, long index)
+{
+    ulist_node_t *n;
+
+    if (index < 0) {
+        index = (-index)-1;
+        n = list->tail;
+        while(n && index >= (long)n->count) {
+            index -= n->count;
+            n = n->prev;
+        }
+        return n ? &n->values[n->count-1-index] : NULL;
+    } else {
+        n = list->head;
+        while(n && index >= (long)n->count) {
+            index -= n->count;
+            n = n->next;
+        }
+        return n ? &n->values[index] : NULL;
+    }
+}
+
+void **ulist_search(ulist_t *list, void *key)
+{
+    ulist_node_t *n;
+    unsigned int j;
+
+    for (n = list->head; n; n = n->next) {
+        for (j = 0; j < n->count; j++) {
+            if (list->match) {
+                if (list->match(n->values[j], key))
+                    return &n->values[j];
+            } else {
+                if (key == n->values[j])
+                    return &n->values[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+void ulist_rewind(ulist_t *list, ulist_iter_t *iter)
+{
+    iter->node = list->head;
+    iter->offset = 0;
+    iter->direction = ULIST_HEAD;
+}
+
+void ulist_rewind_tail(ulist_t *list, ulist_iter_t *iter)
+{
+    iter->node = list->tail;
+    iter->offset = list->tail ? (long)list->tail->count-1 : 0;
+    iter->direction = ULIST_TAIL;
+}
+
+/* The iterator always designates the value to be returned next, so it
+ * moves to the following node as soon as the current one is exhausted. */
+void **ulist_next(ulist_iter_t *iter)
+{
+    ulist_node_t *current = iter->node;
+    void **slot;
+
+    if (current == NULL) return NULL;
+    slot = &current->values[iter->offset];
+    if (iter->direction == ULIST_HEAD) {
+        if (++iter->offset == (long)current->count) {
+            iter->node = current->next;
+            iter->offset = 0;
+        }
+    } else {
+        if (--iter->offset < 0) {
+            iter->node = current->prev;
+            iter->offset = iter->node ? (long)iter->node->count-1 : 0;
+        }
+    }
+    return slot;
+}
+
+void ulist_remove(ulist_t *list, ulist_iter_t *iter)
+{
+    ulist_node_t *node;
+    long offset;
+
+    /* Find the value last returned from where the iterator stands. */
+    if (iter->direction == ULIST_HEAD) {
+        if (iter->node && iter->offset > 0) {
+            node = iter->node;
+            offset = iter->offset-1;
+            iter->offset--;
+        } else {
+            node = iter->node ? iter->node->prev : list->tail;
+            offset = node->count-1;
+        }
+    } else {
+        if (iter->node && iter->offset+1 < (long)iter->node->count) {
+            node = iter->node;
+            offset = iter->offset+1;
+        } else {
+            node = iter->node ? iter->node->next : list->head;
+            offset = 0;
+        }
+    }
+    if (list->free) list->free(node->values[offset]);
+    /* A node only becomes empty when the iterator already left it, so
+     * releasing it never invalidates the iterator. */
+    ulist_node_remove(list, node, offset);
+}
@@ -0,0 +1,119 @@
+/* ulist.h - An unrolled doubly linked list of pointers
+ *
+ * Every node stores up to ULIST_NODE_FILL values in a plain array, in the
+ * spirit of the redis quicklist, so a sequential scan touches contiguous
+ * memory and the per value overhead drops from a whole list_node_t to a
+ * single pointer plus a share of the node header.
+ *
+ * The API mirrors list.h: ulist_add()/ulist_add_head() append values,
+ * ulist_index() does positional access and ulist_next() iterates, but
+ * since values are not in a node of their own, positions are returned as
+ * a pointer to the value slot instead of a node. The slot is valid until
+ * the list is next modified.
+ */
+
+#ifndef __ULIST_H__
+#define __ULIST_H__
+
+/* Number of values stored in a node: 32 pointers are four cache lines. */
+#define ULIST_NODE_FILL 32
+
+typedef struct ulist_node {
+    struct ulist_node *prev;
+    struct ulist_node *next;
+    unsigned int count;
+    void *values[ULIST_NODE_FILL];
+} ulist_node_t;
+
+typedef struct ulist_iter {
+    ulist_node_t *node;
+    long offset;
+    int direction;
+} ulist_iter_t;
+
+typedef struct ulist {
+    ulist_node_t *head;
+    ulist_node_t *tail;
+    void (*free)(void *ptr);
+    int (*match)(void *ptr, void *key);
+    unsigned long len;
+    unsigned long nodes;
+} ulist_t;
+
+/* Functions implemented as macros */
+#define ulist_size(l) ((l)->len)
+#define ulist_node_count(l) ((l)->nodes)
+
+#define ulist_set_free_method(l,m) ((l)->free = (m))
+#define ulist_set_match_method(l,m) ((l)->match = (m))
+
+#define ulist_get_free_method(l) ((l)->free)
+#define ulist_get_match_method(l) ((l)->match)
+
+/* Walk the list with an iterator in caller provided storage:
+ *
+ * ulist_foreach(list, iter, slot) {
+ *     doSomethingWith(*slot);
+ * }
+ */
+#define ulist_foreach(l,iter,slot) \
+    for (ulist_rewind((l), &(iter)); ((slot) = ulist_next(&(iter))) != NULL; )
+
+/* Directions for iterators and ulist_pop() */
+#define ULIST_HEAD 0
+#define ULIST_TAIL 1
+
+/* Prototypes */
+/* Create a new empty list.
+ *
+ * On error, NULL is returned. Otherwise the pointer to the new list. */
+ulist_t *ulist_create(void);
+
+/* Free the whole list, calling the free method on every value if set.
+ * This function can't fail. */
+void ulist_free(ulist_t *list);
+
+/* Add 'value' to the head or to the tail of the list.
+ *
+ * On error, NULL is returned and the list remains unaltered.
+ * On success the 'list' pointer you pass to the function is returned. */
+ulist_t *ulist_add_head(ulist_t *list, void *value);
+ulist_t *ulist_add(ulist_t *list, void *value);
+
+/* Remove the value at the head (ULIST_HEAD) or at the tail (ULIST_TAIL)
+ * of the list and store it in '*value'. The free method is not called.
+ *
+ * Returns 1 if a value was popped, 0 if the list is empty. */
+int ulist_pop(ulist_t *list, int where, void **value);
+
+/* Return the slot of the value at the specified zero-based index, with
+ * negative indexes counting from the tail as in list_index(). Nodes are
+ * skipped whole, so this walks at most n/ULIST_NODE_FILL nodes.
+ * If the index is out of range NULL is returned. */
+void **ulist_index(ulist_t *list, long index);
+
+/* Search the list for a value matching 'key' with the match method, or
+ * by pointer comparison if no match method is set. Returns the slot of
+ * the first match from the head, or NULL. */
+void **ulist_search(ulist_t *list, void *key);
+
+/* Initialize an iterator in caller provided storage. */
+void ulist_rewind(ulist_t *list, ulist_iter_t *iter);
+void ulist_rewind_tail(ulist_t *list, ulist_iter_t *iter);
+
+/* Return the slot of the next value of the iteration, or NULL when
+ * there are no more values:
+ *
+ * ulist_rewind(list, &iter);
+ * while ((slot = ulist_next(&iter)) != NULL) {
+ *     doSomethingWith(*slot);
+ * }
+ */
+void **ulist_next(ulist_iter_t *iter);
+
+/* Remove the value last returned by ulist_next(), calling the free
+ * method on it. The iterator stays valid and continues with the value
+ * that followed the removed one. */
+void ulist_remove(ulist_t *list, ulist_iter_t *iter);
+
+#endif /* __ULIST_H__ */
@@ -0,0 +1,407 @@
+#include "hash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+/* Built four times: hash_bench with the library as is, hash_bench_sync
+ * compiling hash.c with HASH_REHASH_STEP=0, hash_bench_modulo with
+ * HASH_BUCKET_MODULO and hash_bench_nopool with HASH_POOL_SLAB=0, so the
+ * same run shows the insert latency with and without incremental
+ * rehashing, the find path with masked and with modulo bucket indexes,
+ * and churn with pooled and with malloc()ed elements. */
+#ifndef BENCH_NAME
+# define BENCH_NAME "incremental"
+#endif
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static long long nstime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long long)ts.tv_sec)*1000000000 + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Insert 'len' keys timing every single insert, then report the
+ * throughput and the tail of the latency distribution. */
+static void bench_insert_latency(long len)
+{
+    long long *lat = malloc(sizeof(long long)*len);
+    char **keys = malloc(sizeof(char*)*len);
+    long long start, t;
+    Hash h;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        keys[i] = malloc(24);
+        sprintf(keys[i], "key:%ld", i);
+    }
+    sqlite3HashInit(&h);
+    start = ustime();
+    for (i = 0; i < len; i++) {
+        t = nstime();
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+        lat[i] = nstime()-t;
+    }
+    t = ustime()-start;
+    if (t <= 0) t = 1;
+    qsort(lat, len, sizeof(long long), cmp_ll);
+    printf("%-12s %10ld inserts %8lld us %12.0f ops/sec  "
+           "p50 %lld ns  p99 %lld ns  p99.9 %lld ns  max %lld ns\n",
+           BENCH_NAME, len, t, (double)len*1000000/t,
+           lat[len/2], lat[len/100*99], lat[len/1000*999], lat[len-1]);
+    sqlite3HashClear(&h);
+    for (i = 0; i < len; i++) free(keys[i]);
+    free(keys);
+    free(lat);
+}
+
+static void report(const char *name, long ops, long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-12s %-24s %10ld ops %8lld us %12.0f ops/sec\n",
+           BENCH_NAME, name, ops, us, (double)ops*1000000/us);
+}
+
+/* Short keys looked up in random order: the bucket index is a larger
+ * share of the work than with long keys. */
+static void bench_short_keys(long len)
+{
+    char *keys = malloc((size_t)len*16);
+    unsigned long seed = 1;
+    long long start;
+    long i, found = 0;
+    Hash h;
+
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*16, "key:%ld", i);
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsertKey(&h, keys+i*16, 16, keys+i*16);
+    start = ustime();
+    for (i = 0; i < 10000000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        found += sqlite3HashFindKey(&h, keys+(seed>>33)%len*16, 16) != NULL;
+    }
+    report("short keys find hit", 10000000, ustime()-start);
+    if (found != 10000000) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+    free(keys);
+}
+
+/* Load 'len' keys into a new table, growing it as the keys come in and
+ * then with room reserved for all of them up front. */
+static void bench_load(long len)
+{
+    char *keys = malloc((size_t)len*16);
+    long long start;
+    long i;
+    Hash h;
+
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*16, "key:%ld", i);
+    start = ustime();
+    sqlite3HashInit(&h);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*16, keys+i*16);
+    report("load", len, ustime()-start);
+    sqlite3HashClear(&h);
+
+    start = ustime();
+    sqlite3HashInitSize(&h, (unsigned int)len);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*16, keys+i*16);
+    report("load reserved", len, ustime()-start);
+    sqlite3HashClear(&h);
+    free(keys);
+}
+
+/* Random lookups of 'len' keys, one at a time and in batches of 'batch'
+ * keys, as a request fanning out to many keys would. */
+static void bench_find_batch(long len, int batch)
+{
+    char *keys = malloc((size_t)len*16);
+    const char **batch_keys = malloc(sizeof(char*)*batch);
+    void **data = malloc(sizeof(void*)*batch);
+    unsigned long seed = 1;
+    long long start;
+    long i, found = 0, ops = 10000000/batch*batch;
+    char name[32];
+    int j;
+    Hash h;
+
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*16, "key:%ld", i);
+    sqlite3HashInit(&h);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*16, keys+i*16);
+    while (sqlite3HashRehash(&h, 1000));
+    start = ustime();
+    for (i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        found += sqlite3HashFind(&h, keys+(seed>>33)%len*16) != NULL;
+    }
+    report("find one by one", ops, ustime()-start);
+    seed = 1;
+    start = ustime();
+    for (i = 0; i < ops; i += batch) {
+        for (j = 0; j < batch; j++) {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            batch_keys[j] = keys+(seed>>33)%len*16;
+        }
+        sqlite3HashFindBatch(&h, batch_keys, NULL, batch, data);
+        for (j = 0; j < batch; j++) found += data[j] != NULL;
+    }
+    sprintf(name, "find batch of %d", batch);
+    report(name, ops, ustime()-start);
+    if (found != ops*2) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+    free(keys);
+    free(batch_keys);
+    free(data);
+}
+
+/* Look up the keys of a table in random order. */
+static void bench_find(Hash *h, const char *name, char *keys, long from,
+                       long to)
+{
+    unsigned long seed = 1;
+    long long start;
+    long i, found = 0;
+
+    start = ustime();
+    for (i = 0; i < 10000000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        found += sqlite3HashFind(h, keys+(from+(seed>>33)%(to-from))*16)
+                 != NULL;
+    }
+    report(name, 10000000, ustime()-start);
+    if (found != 10000000) printf("unexpected: %ld keys found\n", found);
+}
+
+/* Grow a table to 'len' keys and drain it to 'keep': the bucket array
+ * shrinks as the keys are deleted, and compaction then packs the
+ * remaining elements together. */
+static void bench_drain(long len, long keep)
+{
+    char *keys = malloc((size_t)len*16);
+    long long start;
+    long i;
+    Hash h;
+
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*16, "key:%ld", i);
+    sqlite3HashInit(&h);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*16, keys+i*16);
+    start = ustime();
+    for (i = 0; i < len-keep; i++)
+        sqlite3HashInsert(&h, keys+i*16, NULL);
+    report("drain delete", len-keep, ustime()-start);
+    while (sqlite3HashRehash(&h, 1000));
+    printf("%-12s %u buckets after drain\n", BENCH_NAME, h.htsize);
+    bench_find(&h, "drained find", keys, len-keep, len);
+    start = ustime();
+    sqlite3HashCompact(&h);
+    report("compact", keep, ustime()-start);
+    printf("%-12s %u buckets after compact\n", BENCH_NAME, h.htsize);
+    bench_find(&h, "compacted find", keys, len-keep, len);
+    sqlite3HashClear(&h);
+    free(keys);
+}
+
+/* A table of 'len' keys churned 'ops' times: each step deletes the
+ * oldest key and inserts a new one, so every step frees an element and
+ * allocates another. */
+static void bench_churn(long len, long ops)
+{
+    char *keys = malloc((size_t)len*2*16);
+    long long start;
+    long i;
+    Hash h;
+
+    for (i = 0; i < len*2; i++)
+        sprintf(keys+i*16, "key:%ld", i);
+    sqlite3HashInit(&h);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*16, keys+i*16);
+    start = ustime();
+    for (i = 0; i < ops; i++) {
+        char *old = keys+i%(len*2)*16, *new = keys+(i+len)%(len*2)*16;
+        sqlite3HashInsert(&h, old, NULL);
+        sqlite3HashInsert(&h, new, new);
+    }
+    report("churn delete+insert", ops, ustime()-start);
+    start = ustime();
+    sqlite3HashClear(&h);
+    report("clear", len, ustime()-start);
+    free(keys);
+}
+
+/* A custom key class with the semantics of SQLITE_HASH_BINARY, to
+ * measure the cost of calling through HashKeyMethods. */
+static unsigned int fnv_hash(void *pAppData, const void *pKey, int nKey)
+{
+    const unsigned char *z = pKey;
+    unsigned int h = 2166136261u;
+
+    (void)pAppData;
+    while (nKey--) h = (h ^ *z++) * 16777619u;
+    return h;
+}
+
+static int bytes_compare(void *pAppData, const void *pKey1, int nKey1,
+                         const void *pKey2, int nKey2)
+{
+    (void)pAppData;
+    return nKey1 != nKey2 || memcmp(pKey1, pKey2, nKey1);
+}
+
+static const HashKeyMethods custom_methods = {
+    fnv_hash, bytes_compare, NULL
+};
+
+static const char *class_name(int keyClass)
+{
+    return keyClass == SQLITE_HASH_STRING ? "nocase" :
+           keyClass == SQLITE_HASH_BINARY ? "case" : "custom";
+}
+
+/* URL-like keys of more than 100 bytes sharing a long prefix, so chains
+ * hold keys that only differ near their end: insert them, look them all
+ * up, and look up as many keys that are not in the table. The table is
+ * of the given key class. */
+static void bench_long_keys(long len, int keyClass)
+{
+    static const char *prefix =
+        "https://www.example.com/static/assets/images/thumbnails/"
+        "2024/collections/summer/";
+    char **keys = malloc(sizeof(char*)*len);
+    char **misses = malloc(sizeof(char*)*len);
+    char name[64];
+    long long start;
+    long i, found = 0;
+    Hash h;
+
+    for (i = 0; i < len; i++) {
+        keys[i] = malloc(256);
+        sprintf(keys[i], "%sitem-%08ld.jpg?size=large&format=webp", prefix, i);
+        misses[i] = malloc(256);
+        sprintf(misses[i], "%sitem-%08ld.jpg?size=small&format=webp", prefix, i);
+    }
+    sqlite3HashInit(&h);
+    if (keyClass == SQLITE_HASH_CUSTOM)
+        sqlite3HashSetKeyMethods(&h, &custom_methods);
+    else
+        sqlite3HashSetKeyClass(&h, keyClass);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+    sprintf(name, "long keys %s insert", class_name(keyClass));
+    report(name, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        found += sqlite3HashFind(&h, keys[i]) != NULL;
+    sprintf(name, "long keys %s hit", class_name(keyClass));
+    report(name, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        found += sqlite3HashFind(&h, misses[i]) != NULL;
+    sprintf(name, "long keys %s miss", class_name(keyClass));
+    report(name, len, ustime()-start);
+
+    if (found != len) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+    for (i = 0; i < len; i++) {
+        free(keys[i]);
+        free(misses[i]);
+    }
+    free(keys);
+    free(misses);
+}
+
+/* 16 byte binary ids, looked up in a binary table, against the same ids
+ * spelled as 32 hex digits in a string table, by length and with the
+ * length taken from strlen(). */
+static void bench_binary_keys(long len)
+{
+    unsigned char *ids = malloc((size_t)len*16);
+    char *hex = malloc((size_t)len*33);
+    unsigned long long seed = 1;
+    long long start;
+    long i, found = 0;
+    Hash h;
+    int j;
+
+    for (i = 0; i < len*16; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        ids[i] = (unsigned char)(seed >> 56);
+    }
+    for (i = 0; i < len; i++)
+        for (j = 0; j < 16; j++)
+            sprintf(hex+i*33+j*2, "%02x", ids[i*16+j]);
+
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    for (i = 0; i < len; i++)
+        sqlite3HashInsertKey(&h, ids+i*16, 16, ids+i*16);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        found += sqlite3HashFindKey(&h, ids+i*16, 16) != NULL;
+    report("binary 16B FindKey", len, ustime()-start);
+    sqlite3HashClear(&h);
+
+    for (i = 0; i < len; i++)
+        sqlite3HashInsertKey(&h, hex+i*33, 32, hex+i*33);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        found += sqlite3HashFindKey(&h, hex+i*33, 32) != NULL;
+    report("hex 32B FindKey", len, ustime()-start);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        found += sqlite3HashFind(&h, hex+i*33) != NULL;
+    report("hex 32B Find", len, ustime()-start);
+    sqlite3HashClear(&h);
+
+    if (found != len*3) printf("unexpected: %ld keys found\n", found);
+    free(ids);
+    free(hex);
+}
+
+int main(int argc, char **argv)
+{
+    long len = argc > 1 ? atol(argv[1]) : 10000000;
+    long long_len = argc > 2 ? atol(argv[2]) : 1000000;
+
+    bench_insert_latency(len);
+    bench_short_keys(1000);
+    bench_short_keys(long_len);
+    bench_churn(long_len, 10000000);
+    bench_load(len);
+    bench_drain(len, 1000);
+    bench_find_batch(long_len, 64);
+    bench_find_batch(long_len, 256);
+    bench_long_keys(long_len, SQLITE_HASH_STRING);
+    bench_long_keys(long_len, SQLITE_HASH_BINARY);
+    bench_long_keys(long_len, SQLITE_HASH_CUSTOM);
+    bench_binary_keys(long_len);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/* The hash function of hash.c on its own: speed per key size, and how
+ * evenly it spreads our key sets. hash.c is compiled in, so its static
+ * functions can be called directly; hash_func_bench uses the default
+ * function and hash_func_bench_knuth is built with HASH_FUNC_KNUTH. */
+#include "hash.c"
+#include <stdio.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+#if HASH_FUNC==HASH_FUNC_KNUTH
+#define FUNC_NAME "knuth"
+#else
+#define FUNC_NAME "wyhash"
+#endif
+
+#define MAX_KEY 128
+
+/* A key set: 'n' keys of at most MAX_KEY bytes and their lengths. */
+typedef struct keyset {
+    const char *name;
+    int binary;
+    long n;
+    char *keys;
+    int *lens;
+} keyset;
+
+static unsigned long long seed = 1;
+
+static unsigned int rnd(void)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(seed >> 33);
+}
+
+static void keyset_init(keyset *ks, const char *name, int binary, long n)
+{
+    ks->name = name;
+    ks->binary = binary;
+    ks->n = n;
+    ks->keys = calloc((size_t)n, MAX_KEY);
+    ks->lens = malloc(sizeof(int)*n);
+}
+
+/* The key sets we use: sequential short names, 40 byte session keys,
+ * long URLs sharing a prefix, and random 16 byte binary ids. */
+static void make_keysets(keyset *sets, long n)
+{
+    long i;
+    int j;
+
+    keyset_init(&sets[0], "key:N", 0, n);
+    keyset_init(&sets[1], "40B session", 0, n);
+    keyset_init(&sets[2], "URL", 0, n);
+    keyset_init(&sets[3], "16B binary", 1, n);
+    for (i = 0; i < n; i++) {
+        char *k;
+
+        k = sets[0].keys+i*MAX_KEY;
+        sets[0].lens[i] = sprintf(k, "key:%ld", i);
+        k = sets[1].keys+i*MAX_KEY;
+        sets[1].lens[i] = sprintf(k, "User:%08ld:Session:%08X:Web:%06ld",
+                                  i, rnd(), i%997);
+        k = sets[2].keys+i*MAX_KEY;
+        sets[2].lens[i] = sprintf(k, "https://www.example.com/static/"
+                                  "assets/images/thumbnails/2024/item-%08ld"
+                                  ".jpg?size=large&format=webp", i);
+        k = sets[3].keys+i*MAX_KEY;
+        for (j = 0; j < 16; j++) k[j] = (char)rnd();
+        sets[3].lens[i] = 16;
+    }
+}
+
+static unsigned int hash_key(const keyset *ks, long i)
+{
+    const char *k = ks->keys+i*MAX_KEY;
+    return ks->binary ? binHash(k, ks->lens[i]) : strHash(k, ks->lens[i]);
+}
+
+/* Hash the first SPEED_KEYS keys of the set, which stay in the cache,
+ * as many times over as there are keys in the set, 'rounds' times. */
+#define SPEED_KEYS 1024
+
+static void bench_speed(const keyset *ks, int rounds)
+{
+    long n = ks->n < SPEED_KEYS ? ks->n : SPEED_KEYS;
+    long passes = ks->n/n*rounds, i, p, bytes = 0;
+    long long start, us;
+    unsigned int sum = 0;
+
+    for (i = 0; i < n; i++) bytes += ks->lens[i];
+    start = ustime();
+    for (p = 0; p < passes; p++)
+        for (i = 0; i < n; i++)
+            sum += hash_key(ks, i);
+    us = ustime()-start;
+    if (us <= 0) us = 1;
+    printf("%-8s %-12s avg %5.1f bytes %8.2f ns/key %8.2f GB/s (%08x)\n",
+           FUNC_NAME, ks->name, (double)bytes/n,
+           (double)us*1000/((double)n*passes),
+           (double)bytes*passes/us/1000, sum);
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Spread of the keys over 'm' buckets, picked with '% m', or as the
+ * table does when m is a power of two: the number of colliding pairs
+ * relative to a uniform hash (1.00 is ideal) and the longest chain. */
+static void bucket_score(const unsigned int *h, long n, unsigned int m,
+                         double *score, unsigned int *longest)
+{
+    unsigned int *count = calloc(m, sizeof(unsigned int));
+    double pairs = 0;
+    long i;
+
+    *longest = 0;
+    for (i = 0; i < n; i++) {
+        unsigned int b = (m & (m-1)) == 0 ? hashBucket(h[i], m) : h[i] % m;
+        pairs += count[b]++;
+        if (count[b] > *longest) *longest = count[b];
+    }
+    *score = pairs / ((double)n*(n-1)/2/m);
+    free(count);
+}
+
+static void check_distribution(const keyset *ks)
+{
+    unsigned int *h = malloc(sizeof(unsigned int)*ks->n);
+    unsigned int pow2 = 1, longest_mod, longest_pow2;
+    double score_mod, score_pow2, expect;
+    long i, dups = 0;
+
+    for (i = 0; i < ks->n; i++) h[i] = hash_key(ks, i);
+    while (pow2 < ks->n) pow2 <<= 1;
+    bucket_score(h, ks->n, (unsigned int)ks->n/2*2+1, &score_mod,
+                 &longest_mod);
+    bucket_score(h, ks->n, pow2, &score_pow2, &longest_pow2);
+    qsort(h, ks->n, sizeof(unsigned int), cmp_uint);
+    for (i = 1; i < ks->n; i++) dups += h[i] == h[i-1];
+    expect = (double)ks->n*(ks->n-1)/2/4294967296.0;
+    printf("%-8s %-12s 32-bit collisions %5ld (uniform %.1f)  "
+           "%% odd: %.2f max %u  pow2: %.2f max %u\n",
+           FUNC_NAME, ks->name, dups, expect, score_mod, longest_mod,
+           score_pow2, longest_pow2);
+    free(h);
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+    keyset sets[4];
+    int j;
+
+    make_keysets(sets, n);
+    for (j = 0; j < 4; j++) bench_speed(&sets[j], rounds);
+    for (j = 0; j < 4; j++) check_distribution(&sets[j]);
+    for (j = 0; j < 4; j++) {
+        free(sets[j].keys);
+        free(sets[j].lens);
+    }
+    return 0;
+}
@@ -0,0 +1,486 @@
+#include "hash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TESTHELP_KEYS
+#include "testhelp.h"
+
+/* Check that keys[from..to-1] map to themselves and nothing else is in
+** the table, by count and by walking the element list. */
+static int hash_check(Hash *h, int from, int to)
+{
+    HashElem *e;
+    int i, n = 0;
+
+    for (i = 0; i < N_KEYS; i++) {
+        void *data = sqlite3HashFind(h, keys[i]);
+        if (data != (i >= from && i < to ? keys[i] : NULL)) return 0;
+    }
+    for (e = sqliteHashFirst(h); e; e = sqliteHashNext(e)) n++;
+    return n == to-from && (int)h->count == n;
+}
+
+/* Check that the table holds n elements, by count and by walking the
+** element list. */
+static int hash_check_count(Hash *h, int n)
+{
+    HashElem *e;
+    int i = 0;
+
+    for (e = sqliteHashFirst(h); e; e = sqliteHashNext(e)) i++;
+    return i == n && (int)h->count == n;
+}
+
+static void test_basic(void)
+{
+    Hash h;
+    int i;
+
+    sqlite3HashInit(&h);
+    test_cond("empty find", sqlite3HashFind(&h, "missing") == NULL);
+    for (i = 0; i < N_KEYS; i++)
+        if (sqlite3HashInsert(&h, keys[i], keys[i]) != NULL) break;
+    test_cond("insert", i == N_KEYS && hash_check(&h, 0, N_KEYS));
+    test_cond("buckets grown",
+              (h.htNew ? h.htsizeNew : h.htsize) >= N_KEYS/2);
+    test_cond("power of two buckets", (h.htsize & (h.htsize-1)) == 0 &&
+              (h.htsizeNew & (h.htsizeNew-1)) == 0);
+    test_cond("case insensitive", sqlite3HashFind(&h, "KEY:42") == keys[42]);
+    test_cond("replace", sqlite3HashInsert(&h, "KEY:7", keys[8]) == keys[7] &&
+              sqlite3HashFind(&h, "key:7") == keys[8]);
+    sqlite3HashInsert(&h, keys[7], keys[7]);
+    for (i = 0; i < N_KEYS/2; i++)
+        if (sqlite3HashInsert(&h, keys[i], NULL) != keys[i]) break;
+    test_cond("delete", i == N_KEYS/2 && hash_check(&h, N_KEYS/2, N_KEYS));
+    test_cond("delete missing", sqlite3HashInsert(&h, "missing", NULL) == NULL);
+    for (i = N_KEYS/2; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], NULL);
+    test_cond("delete all", h.count == 0 && h.ht == NULL && h.first == NULL);
+    for (i = 0; i < 100; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    sqlite3HashClear(&h);
+    test_cond("clear", h.count == 0 && sqlite3HashFind(&h, keys[1]) == NULL);
+}
+
+static void test_rehash(void)
+{
+    Hash h;
+    int i, steps, seen = 0;
+
+    sqlite3HashInit(&h);
+    /* Interleave deletes with the inserts, checking the table at every
+    ** step while a rehash is in progress. */
+    for (i = 0; i < N_KEYS; i++) {
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+        if (i % 3 == 2) sqlite3HashInsert(&h, keys[i-1], NULL);
+        if (h.htNew && seen++ < 50 && i % 3 == 2) {
+            int j, ok = 1;
+            for (j = 0; j <= i && ok; j++)
+                ok = sqlite3HashFind(&h, keys[j]) ==
+                     (j % 3 == 1 ? NULL : keys[j]);
+            test_cond("find during rehash", ok);
+        }
+    }
+    test_cond("rehash started", seen > 0);
+    for (i = 1; i < N_KEYS; i += 3) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("contents after rehash", hash_check(&h, 0, N_KEYS));
+    sqlite3HashClear(&h);
+
+    /* Stop inserting right after a rehash starts and finish it by hand. */
+    sqlite3HashInit(&h);
+    for (i = 0; i < N_KEYS && h.htNew == NULL; i++)
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("rehash in progress", h.htNew != NULL);
+    for (steps = 0; sqlite3HashRehash(&h, 1); steps++);
+    test_cond("rehash steps", steps > 0 && h.htNew == NULL &&
+              h.htsize >= (unsigned)i && hash_check(&h, 0, i));
+    test_cond("rehash idle", sqlite3HashRehash(&h, 10) == 0 &&
+              sqlite3HashRehashMs(&h, 1) == 0);
+    for (; i < N_KEYS && h.htNew == NULL; i++)
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("rehash by time", h.htNew != NULL &&
+              sqlite3HashRehashMs(&h, 1000) == 0 && h.htNew == NULL &&
+              hash_check(&h, 0, i));
+    sqlite3HashClear(&h);
+
+    for (i = 0; i < N_KEYS && h.htNew == NULL; i++)
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+    sqlite3HashRehash(&h, 1);
+    sqlite3HashClear(&h);
+    test_cond("clear during rehash", h.htNew == NULL && h.iRehash == 0 &&
+              h.ht == NULL && sqlite3HashFind(&h, keys[0]) == NULL);
+}
+
+static void test_binary_keys(void)
+{
+    static unsigned char ids[N_KEYS][12];
+    HashElem *e;
+    Hash h;
+    int i, n, ok;
+
+    /* 12 byte ids that differ only in their middle bytes, with NUL bytes
+    ** all around, and upper and lower case letters at the end. */
+    memset(ids, 0, sizeof(ids));
+    for (i = 0; i < N_KEYS; i++) {
+        ids[i][5] = (unsigned char)(i & 0xff);
+        ids[i][6] = (unsigned char)(i >> 8);
+        ids[i][11] = i & 1 ? 'A' : 'a';
+    }
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    for (i = 0; i < N_KEYS; i++)
+        sqlite3HashInsertKey(&h, ids[i], 12, ids[i]);
+    for (i = 0, ok = 1; i < N_KEYS && ok; i++)
+        ok = sqlite3HashFindKey(&h, ids[i], 12) == ids[i] &&
+             sqlite3HashFindKey(&h, ids[i], 11) == NULL;
+    test_cond("binary find", ok && h.count == N_KEYS);
+    n = 0;
+    for (e = sqliteHashFirst(&h); e; e = sqliteHashNext(e))
+        n += sqliteHashKeysize(e) == 12 && sqliteHashKey(e) == sqliteHashData(e);
+    test_cond("binary keys iterated", n == N_KEYS);
+    for (i = 0; i < N_KEYS; i += 2)
+        sqlite3HashInsertKey(&h, ids[i], 12, NULL);
+    for (i = 0, ok = 1; i < N_KEYS && ok; i++)
+        ok = sqlite3HashFindKey(&h, ids[i], 12) == (i & 1 ? ids[i] : NULL);
+    test_cond("binary delete", ok && h.count == N_KEYS/2);
+    test_cond("binary string api",
+              sqlite3HashInsert(&h, "abc", keys[0]) == NULL &&
+              sqlite3HashFindKey(&h, "abc", 3) == keys[0] &&
+              sqlite3HashFind(&h, "ABC") == NULL);
+    sqlite3HashClear(&h);
+
+    /* String keys with an explicit length match their prefix only. */
+    sqlite3HashInit(&h);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("string key length",
+              sqlite3HashFindKey(&h, "KEY:123xyz", 7) == keys[123] &&
+              sqlite3HashFindKey(&h, "key:123", 6) == keys[12] &&
+              sqlite3HashInsertKey(&h, "key:5!", 5, keys[6]) == keys[5] &&
+              sqlite3HashFind(&h, "key:5") == keys[6]);
+    sqlite3HashClear(&h);
+}
+
+/* Keys of every length up to 100 bytes, found again with their case
+** changed: the hash function must fold short keys, long keys and tails
+** alike. */
+static void test_case_fold(void)
+{
+    static char lower[101][101], upper[101][101];
+    unsigned long seed = 1;
+    Hash h;
+    int i, j, ok = 1;
+
+    sqlite3HashInit(&h);
+    for (i = 0; i <= 100; i++) {
+        for (j = 0; j < i; j++) {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            lower[i][j] = "abcxyz@[`{09-_\xc1\xda"[(seed >> 33) % 16];
+            upper[i][j] = lower[i][j] >= 'a' && lower[i][j] <= 'z' ?
+                          lower[i][j]-'a'+'A' : lower[i][j];
+        }
+        sqlite3HashInsert(&h, lower[i], lower[i]);
+    }
+    for (i = 0; i <= 100 && ok; i++)
+        ok = sqlite3HashFind(&h, upper[i]) == lower[i];
+    test_cond("case folded hash", ok && h.count == 101);
+    test_cond("only ASCII is folded",
+              sqlite3HashFind(&h, "\xe1\xfa") == NULL &&
+              sqlite3HashInsert(&h, "\xe1\xfa", upper[0]) == NULL &&
+              sqlite3HashFind(&h, "\xc1\xda") == NULL);
+    sqlite3HashClear(&h);
+}
+
+/* Custom keys: "name:version", where the version is ignored. */
+static unsigned int name_len(const void *pKey, int nKey)
+{
+    const char *colon = memchr(pKey, ':', nKey);
+    return colon ? (unsigned int)(colon-(const char*)pKey) : (unsigned)nKey;
+}
+
+static unsigned int name_hash(void *pAppData, const void *pKey, int nKey)
+{
+    const unsigned char *z = pKey;
+    unsigned int h = 0, n = name_len(pKey, nKey);
+
+    (void)pAppData;
+    while (n--) h = h*31 + *z++;
+    return h;
+}
+
+static int name_compare(void *pAppData, const void *pKey1, int nKey1,
+                        const void *pKey2, int nKey2)
+{
+    unsigned int n1 = name_len(pKey1, nKey1), n2 = name_len(pKey2, nKey2);
+
+    (*(int*)pAppData)++;
+    return n1 != n2 || memcmp(pKey1, pKey2, n1);
+}
+
+static void test_key_classes(void)
+{
+    static int compares = 0;
+    static const HashKeyMethods by_name = {
+        name_hash, name_compare, &compares
+    };
+    char *name, *short_name;
+    Hash h;
+    int i, ok;
+
+    /* Case sensitive strings are binary keys. */
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("case sensitive", sqlite3HashFind(&h, "key:42") == keys[42] &&
+              sqlite3HashFind(&h, "KEY:42") == NULL &&
+              sqlite3HashInsert(&h, "Key:42", keys[0]) == NULL &&
+              h.count == N_KEYS+1 && hash_check_count(&h, N_KEYS+1));
+    sqlite3HashClear(&h);
+
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyMethods(&h, &by_name);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("custom keys", h.count == 1 && compares >= N_KEYS-1 &&
+              sqlite3HashFind(&h, "key") == keys[N_KEYS-1] &&
+              sqlite3HashFind(&h, "key:x") == keys[N_KEYS-1] &&
+              sqlite3HashFind(&h, "KEY") == NULL);
+    sqlite3HashClear(&h);
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyMethods(&h, &by_name);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i]+4, keys[i]);
+    for (i = 0, ok = 1; i < N_KEYS && ok; i++)
+        ok = sqlite3HashFind(&h, keys[i]+4) == keys[i];
+    test_cond("custom keys grown", ok && h.count == N_KEYS && h.htsize > 0);
+    sqlite3HashClear(&h);
+
+    /* Replacing a key by an equal one of another length: the table must
+     * forget the old key and its length, as the old key may be freed. */
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyMethods(&h, &by_name);
+    name = strdup("name:version");
+    sqlite3HashInsert(&h, name, keys[0]);
+    short_name = strdup("name");
+    test_cond("custom key replaced",
+              sqlite3HashInsert(&h, short_name, keys[1]) == keys[0] &&
+              sqliteHashKey(sqliteHashFirst(&h)) == short_name &&
+              sqliteHashKeysize(sqliteHashFirst(&h)) == 4);
+    free(name);
+    test_cond("custom key replaced lookup",
+              sqlite3HashFind(&h, "name:other") == keys[1]);
+    sqlite3HashClear(&h);
+    free(short_name);
+}
+
+/* An allocator keeping count of the live allocations. */
+static long live_blocks = 0;
+static long total_blocks = 0;
+static long null_frees = 0;
+
+static void *counting_malloc(void *pAppData, size_t nByte)
+{
+    (void)pAppData;
+    live_blocks++;
+    total_blocks++;
+    return malloc(nByte);
+}
+
+static void counting_free(void *pAppData, void *p)
+{
+    (void)pAppData;
+    if (p)
+        live_blocks--;
+    else
+        null_frees++;
+    free(p);
+}
+
+static void test_allocator(void)
+{
+    static const HashMemMethods counting = {
+        counting_malloc, counting_free, NULL, NULL
+    };
+    Hash h;
+    int i;
+
+    sqlite3HashInit(&h);
+    sqlite3HashSetMem(&h, &counting);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("custom allocator used", live_blocks > 0 &&
+              hash_check(&h, 0, N_KEYS));
+    test_cond("elements pooled", live_blocks < N_KEYS/100);
+    for (i = 0; i < 100000; i++) {
+        sqlite3HashInsert(&h, keys[i%N_KEYS], NULL);
+        sqlite3HashInsert(&h, keys[i%N_KEYS], keys[i%N_KEYS]);
+    }
+    test_cond("pooled elements reused", live_blocks < N_KEYS/100 &&
+              hash_check(&h, 0, N_KEYS));
+    sqlite3HashClear(&h);
+    test_cond("custom allocator freed", live_blocks == 0);
+
+    sqlite3HashConfigMalloc(&counting);
+    sqlite3HashInit(&h);
+    sqlite3HashConfigMalloc(NULL);
+    total_blocks = 0;
+    sqlite3HashInsert(&h, keys[0], keys[0]);
+    test_cond("configured allocator", total_blocks == 1 && live_blocks == 1);
+    sqlite3HashInsert(&h, keys[0], NULL);
+    test_cond("configured allocator freed", live_blocks == 0);
+
+    /* A table that never allocated its buckets frees nothing. */
+    sqlite3HashInit(&h);
+    sqlite3HashSetMem(&h, &counting);
+    sqlite3HashClear(&h);
+    test_cond("xFree never given NULL", null_frees == 0);
+}
+
+/* Once room is reserved for N_KEYS entries, loading them neither
+** allocates nor rehashes. */
+static void test_reserve(void)
+{
+    static const HashMemMethods counting = {
+        counting_malloc, counting_free, NULL, NULL
+    };
+    unsigned int htsize;
+    long blocks;
+    Hash h;
+    int i;
+
+    sqlite3HashConfigMalloc(&counting);
+    test_cond("init with size", sqlite3HashInitSize(&h, N_KEYS));
+    sqlite3HashConfigMalloc(NULL);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    htsize = h.htsize;
+    blocks = total_blocks;
+    for (i = 0; i < N_KEYS; i++)
+        sqlite3HashInsertKey(&h, keys[i], (int)strlen(keys[i]), keys[i]);
+    test_cond("reserved", htsize >= N_KEYS/2 && h.htsize == htsize &&
+              h.htNew == NULL && total_blocks == blocks &&
+              hash_check_count(&h, N_KEYS));
+    test_cond("reserve more", sqlite3HashReserve(&h, N_KEYS*4) &&
+              h.htsize >= N_KEYS*2 && hash_check_count(&h, N_KEYS) &&
+              sqlite3HashFindKey(&h, keys[5], (int)strlen(keys[5])) == keys[5]);
+    htsize = h.htsize;
+    test_cond("reserve less", sqlite3HashReserve(&h, 10) &&
+              h.htsize == htsize);
+    sqlite3HashClear(&h);
+    test_cond("reserve freed", live_blocks == 0);
+}
+
+/* Look up every key, and as many missing ones, with one batch and with
+** single lookups, and compare. The batch passes the key lengths if
+** with_lens is set. */
+static int hash_check_batch(Hash *h, int n, int with_lens)
+{
+    static const char *batch[N_KEYS*2];
+    static int batch_lens[N_KEYS*2];
+    static void *data[N_KEYS*2];
+    static char misses[N_KEYS][16];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        sprintf(misses[i], "miss:%d", i);
+        batch[i*2] = keys[(i*7919) % n];
+        batch[i*2+1] = misses[i];
+        batch_lens[i*2] = (int)strlen(batch[i*2]);
+        batch_lens[i*2+1] = (int)strlen(misses[i]);
+    }
+    sqlite3HashFindBatch(h, batch, with_lens ? batch_lens : NULL, n*2, data);
+    for (i = 0; i < n*2; i++)
+        if (data[i] != sqlite3HashFindKey(h, batch[i], batch_lens[i]))
+            return 0;
+    return 1;
+}
+
+static void test_find_batch(void)
+{
+    Hash h;
+    int i;
+
+    sqlite3HashInit(&h);
+    for (i = 0; i < 5; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("batch without buckets", h.ht == NULL &&
+              hash_check_batch(&h, 5, 0));
+    for (; i < N_KEYS && h.htNew == NULL; i++)
+        sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("batch while rehashing", h.htNew != NULL &&
+              hash_check_batch(&h, i, 0));
+    for (; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("batch", hash_check_batch(&h, N_KEYS, 0));
+    sqlite3HashClear(&h);
+
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    for (i = 0; i < N_KEYS; i++)
+        sqlite3HashInsertKey(&h, keys[i], (int)strlen(keys[i]), keys[i]);
+    test_cond("batch binary keys", hash_check_batch(&h, N_KEYS, 1));
+    sqlite3HashClear(&h);
+}
+
+static void test_shrink(void)
+{
+    static const HashMemMethods counting = {
+        counting_malloc, counting_free, NULL, NULL
+    };
+    unsigned int htsize;
+    long blocks;
+    Hash h;
+    int i, ok = 1, seen = 0;
+
+    /* Drain the table to 100 keys, checking it while it shrinks. */
+    sqlite3HashInit(&h);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    for (i = 0; i < N_KEYS-100; i++) {
+        sqlite3HashInsert(&h, keys[i], NULL);
+        if (h.htNew && h.htsizeNew < h.htsize && i % 7 == 0) {
+            seen++;
+            ok = ok && sqlite3HashFind(&h, keys[i]) == NULL &&
+                 sqlite3HashFind(&h, keys[i+1]) == keys[i+1] &&
+                 sqlite3HashFind(&h, keys[N_KEYS-1]) == keys[N_KEYS-1];
+        }
+    }
+    test_cond("find while shrinking", seen > 0 && ok);
+    while (sqlite3HashRehash(&h, 100));
+    test_cond("shrunk", h.htsize <= 100*8 && h.htsize >= 50 &&
+              hash_check(&h, N_KEYS-100, N_KEYS));
+    htsize = h.htsize;
+    for (i = 0; i < 50; i++) {
+        sqlite3HashInsert(&h, keys[N_KEYS-1-i], NULL);
+        sqlite3HashInsert(&h, keys[N_KEYS-1-i], keys[N_KEYS-1-i]);
+    }
+    test_cond("no shrink on churn", h.htsize == htsize && h.htNew == NULL);
+    sqlite3HashClear(&h);
+
+    /* Compaction gives back the slabs of the deleted elements. */
+    sqlite3HashInit(&h);
+    sqlite3HashSetMem(&h, &counting);
+    for (i = 0; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    for (i = 0; i < N_KEYS-1000; i++) sqlite3HashInsert(&h, keys[i], NULL);
+    blocks = live_blocks;
+    test_cond("compact", sqlite3HashCompact(&h) && live_blocks < blocks &&
+              live_blocks <= 2 && h.htNew == NULL &&
+              h.htsize >= 500 && h.htsize <= 2000 &&
+              hash_check(&h, N_KEYS-1000, N_KEYS));
+    for (i = 0; i < N_KEYS-1000; i++) sqlite3HashInsert(&h, keys[i], keys[i]);
+    test_cond("insert after compact", hash_check(&h, 0, N_KEYS));
+    for (i = 5; i < N_KEYS; i++) sqlite3HashInsert(&h, keys[i], NULL);
+    test_cond("compact small", sqlite3HashCompact(&h) && h.ht == NULL &&
+              hash_check(&h, 0, 5));
+    sqlite3HashClear(&h);
+    test_cond("compact freed", live_blocks == 0);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    make_keys();
+    test_basic();
+    test_rehash();
+    test_binary_keys();
+    test_case_fold();
+    test_key_classes();
+    test_allocator();
+    test_reserve();
+    test_shrink();
+    test_find_batch();
+
+    test_report();
+}
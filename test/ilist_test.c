@@ -0,0 +1,74 @@
+#include "ilist.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "testhelp.h"
+
+struct item {
+    long id;
+    ilist_link_t by_id;
+    ilist_link_t odd;
+};
+
+/* Check that the list holds items 0..len-1 linked through 'by_id'. */
+static int ilist_check_sequence(ilist_t *list, long len)
+{
+    ilist_link_t *link;
+    long i = 0;
+
+    ilist_foreach(list, link) {
+        if (ilist_entry(link, struct item, by_id)->id != i++) return 0;
+    }
+    if (i != len || (long)ilist_size(list) != len) return 0;
+    ilist_foreach_reverse(list, link) {
+        if (ilist_entry(link, struct item, by_id)->id != --i) return 0;
+    }
+    return i == 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct item items[100];
+    ilist_t all, odd;
+    ilist_link_t *link, *next;
+    long i;
+
+    (void)argc;
+    (void)argv;
+    ilist_init(&all);
+    ilist_init(&odd);
+    for (i = 0; i < 100; i++) items[i].id = i;
+    for (i = 1; i < 100; i++) {
+        ilist_add(&all, &items[i].by_id);
+        if (i & 1) ilist_add_head(&odd, &items[i].odd);
+    }
+    ilist_add_head(&all, &items[0].by_id);
+    test_cond("add", ilist_check_sequence(&all, 100));
+    test_cond("two lists", ilist_size(&odd) == 50 &&
+              ilist_entry(ilist_first(&odd), struct item, odd)->id == 99);
+    test_cond("index", ilist_index(&all, 42) == &items[42].by_id &&
+              ilist_index(&all, -1) == &items[99].by_id &&
+              ilist_index(&all, 100) == NULL);
+
+    ilist_remove(&all, &items[50].by_id);
+    test_cond("remove", ilist_size(&all) == 99 &&
+              items[49].by_id.next == &items[51].by_id);
+    ilist_insert(&all, &items[51].by_id, &items[50].by_id, 0);
+    test_cond("insert", ilist_check_sequence(&all, 100));
+
+    ilist_rotate(&all);
+    test_cond("rotate", ilist_first(&all) == &items[99].by_id);
+    ilist_remove(&all, &items[99].by_id);
+    ilist_insert(&all, &items[98].by_id, &items[99].by_id, 1);
+    test_cond("insert after tail", ilist_last(&all) == &items[99].by_id &&
+              ilist_check_sequence(&all, 100));
+
+    ilist_foreach_safe(&odd, link, next) {
+        if (ilist_entry(link, struct item, odd)->id > 10)
+            ilist_remove(&odd, link);
+    }
+    test_cond("foreach_safe", ilist_size(&odd) == 5 &&
+              ilist_check_sequence(&all, 100));
+
+    test_report();
+}
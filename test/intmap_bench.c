@@ -0,0 +1,148 @@
+#include "hash.h"
+#include "intmap.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, long len, long ops, long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-20s %10ld keys %10ld ops %8lld us %12.0f ops/sec\n",
+           name, len, ops, us, (double)ops*1000000/us);
+}
+
+/* 'len' random 64-bit ids, and the order of random lookups: 'ops'
+ * indexes below 'len'. The string path formats every id it looks up, as
+ * callers keyed by ids have to; the ids it inserts are formatted into
+ * 'names', which must outlive the table. */
+#define NAME_SIZE 24
+
+static uint64_t *ids;
+static char *names;
+static long *order;
+
+static void make_ids(long len, long ops)
+{
+    unsigned long long seed = 1;
+    long i;
+
+    ids = malloc(sizeof(uint64_t)*len);
+    names = malloc((size_t)len*NAME_SIZE);
+    order = malloc(sizeof(long)*ops);
+    for (i = 0; i < len; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        ids[i] = seed;
+    }
+    for (i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        order[i] = (long)((seed >> 16) % len);
+    }
+}
+
+static void free_ids(void)
+{
+    free(ids);
+    free(names);
+    free(order);
+}
+
+static void bench_string(long len, long ops)
+{
+    char buf[NAME_SIZE];
+    long long start;
+    long i, found = 0;
+    Hash h;
+
+    sqlite3HashInit(&h);
+    start = ustime();
+    for (i = 0; i < len; i++) {
+        char *name = names+i*NAME_SIZE;
+        snprintf(name, NAME_SIZE, "%llu", (unsigned long long)ids[i]);
+        sqlite3HashInsert(&h, name, &ids[i]);
+    }
+    report("Hash string insert", len, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++) {
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)ids[order[i]]);
+        found += sqlite3HashFind(&h, buf) != NULL;
+    }
+    report("Hash string find", len, ops, ustime()-start);
+    if (found != ops) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+}
+
+/* The ids as 8 byte binary keys: no formatting, but still a byte string
+ * hash and a memcmp() per access. */
+static void bench_binary(long len, long ops)
+{
+    long long start;
+    long i, found = 0;
+    Hash h;
+
+    sqlite3HashInit(&h);
+    sqlite3HashSetKeyClass(&h, SQLITE_HASH_BINARY);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        sqlite3HashInsertKey(&h, &ids[i], sizeof(uint64_t), &ids[i]);
+    report("Hash binary insert", len, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += sqlite3HashFindKey(&h, &ids[order[i]], sizeof(uint64_t))
+                 != NULL;
+    report("Hash binary find", len, ops, ustime()-start);
+    if (found != ops) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+}
+
+static void bench_intmap(long len, long ops)
+{
+    intmap_t *map = intmap_create();
+    long long start;
+    long i, found = 0;
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        intmap_insert(map, ids[i], &ids[i]);
+    report("intmap insert", len, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += intmap_find(map, ids[order[i]]) != NULL;
+    report("intmap find", len, ops, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        intmap_delete(map, ids[i]);
+    report("intmap delete", len, len, ustime()-start);
+    if (found != ops) printf("unexpected: %ld keys found\n", found);
+    intmap_free(map);
+}
+
+/* Every argument is a map size to run, 1K and 1M by default. */
+int main(int argc, char **argv)
+{
+    static const long sizes[] = { 1000, 1000000 };
+    long len, ops;
+    int j, n = argc > 1 ? argc-1 : 2;
+
+    for (j = 0; j < n; j++) {
+        len = argc > 1 ? atol(argv[j+1]) : sizes[j];
+        ops = len < 10000000 ? 10000000 : len;
+        make_ids(len, ops);
+        bench_string(len, ops);
+        bench_binary(len, ops);
+        bench_intmap(len, ops);
+        free_ids();
+    }
+    return 0;
+}
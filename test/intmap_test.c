@@ -0,0 +1,116 @@
+#include "intmap.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testhelp.h"
+
+#define N_KEYS 10000
+
+/* The keys: sequential ids, the extremes, and random 64-bit values. */
+static uint64_t keys[N_KEYS];
+static char data[N_KEYS];
+
+static void make_keys(void)
+{
+    unsigned long long seed = 1;
+    int i;
+
+    keys[0] = 0;
+    keys[1] = UINT64_MAX;
+    for (i = 2; i < N_KEYS/2; i++) keys[i] = (uint64_t)i;
+    for (; i < N_KEYS; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = seed;
+    }
+}
+
+/* Check that keys[i] maps to &data[i] exactly when present[i] is set, by
+ * lookups and by iterating the map. */
+static int intmap_check(intmap_t *map, const char *present)
+{
+    intmap_iter_t iter;
+    intmap_slot_t *slot;
+    size_t n = 0, expect = 0;
+    int i;
+
+    for (i = 0; i < N_KEYS; i++) {
+        if (intmap_find(map, keys[i]) != (present[i] ? &data[i] : NULL))
+            return 0;
+        expect += present[i] != 0;
+    }
+    intmap_foreach(map, iter, slot) {
+        i = (int)((char*)slot->data - data);
+        if (i < 0 || i >= N_KEYS || slot->key != keys[i]) return 0;
+        n++;
+    }
+    return n == expect && intmap_size(map) == n;
+}
+
+static void test_basic(void)
+{
+    intmap_t *map = intmap_create();
+    static char present[N_KEYS];
+    int i;
+
+    test_cond("empty find", intmap_find(map, 0) == NULL &&
+              intmap_delete(map, 0) == NULL);
+    for (i = 0; i < N_KEYS; i++) {
+        if (intmap_insert(map, keys[i], &data[i]) != NULL) break;
+        present[i] = 1;
+    }
+    test_cond("insert", i == N_KEYS && intmap_check(map, present));
+    test_cond("replace", intmap_insert(map, keys[7], &data[8]) == &data[7] &&
+              intmap_find(map, keys[7]) == &data[8]);
+    intmap_insert(map, keys[7], &data[7]);
+    for (i = 0; i < N_KEYS; i += 2) {
+        if (intmap_delete(map, keys[i]) != &data[i]) break;
+        present[i] = 0;
+    }
+    test_cond("delete", i >= N_KEYS && intmap_check(map, present));
+    test_cond("delete missing", intmap_delete(map, keys[0]) == NULL);
+    for (i = 1; i < N_KEYS; i += 4) {
+        if (intmap_insert(map, keys[i], NULL) != &data[i]) break;
+        present[i] = 0;
+    }
+    test_cond("insert NULL deletes", i >= N_KEYS &&
+              intmap_check(map, present));
+    intmap_clear(map);
+    memset(present, 0, sizeof(present));
+    test_cond("clear", intmap_check(map, present));
+    intmap_free(map);
+}
+
+/* Keep a small map at a steady size while churning through all the keys,
+ * so that removals keep moving keys back, across the end of the table
+ * too. */
+static void test_churn(void)
+{
+    intmap_t *map = intmap_create();
+    static char present[N_KEYS];
+    int i, ok = 1;
+
+    for (i = 0; i < N_KEYS; i++) {
+        intmap_insert(map, keys[i], &data[i]);
+        present[i] = 1;
+        if (i >= 11) {
+            intmap_delete(map, keys[i-11]);
+            present[i-11] = 0;
+        }
+        if (i % 97 == 0) ok = ok && intmap_check(map, present);
+    }
+    test_cond("churn", ok && intmap_check(map, present) &&
+              intmap_size(map) == 11);
+    intmap_free(map);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    make_keys();
+    test_basic();
+    test_churn();
+
+    test_report();
+}
@@ -0,0 +1,249 @@
+#include "list.h"
+#include "ulist.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, long ops, long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-28s %10ld ops %8lld us %12.0f ops/sec\n",
+           name, ops, us, (double)ops*1000000/us);
+}
+
+/* Queue workload: push 'batch' values at the tail and pop them all from
+ * the head, 'rounds' times. */
+static void bench_push_pop(const char *name, list_t *list,
+                           long batch, long rounds)
+{
+    long long start;
+    long i, r;
+
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < batch; i++)
+            list_add(list, (void*)i);
+        while (list_size(list))
+            list_remove(list, list_first(list));
+    }
+    report(name, batch*rounds*2, ustime()-start);
+}
+
+/* Sequential scan of 'len' values, 'rounds' times, with the classic list
+ * and with the unrolled one. */
+static void bench_scan(long len, long rounds)
+{
+    list_t *list = list_create();
+    ulist_t *ulist = ulist_create();
+    list_iter_t li;
+    ulist_iter_t ui;
+    list_node_t *node;
+    void **slot;
+    long long start;
+    long i, r, sum = 0;
+
+    for (i = 0; i < len; i++) {
+        list_add(list, (void*)i);
+        ulist_add(ulist, (void*)i);
+    }
+
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        list_rewind(list, &li);
+        while ((node = list_next(&li)) != NULL)
+            sum += (long)list_value(node);
+    }
+    report("scan list", len*rounds, ustime()-start);
+
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        ulist_rewind(ulist, &ui);
+        while ((slot = ulist_next(&ui)) != NULL)
+            sum += (long)*slot;
+    }
+    report("scan ulist", len*rounds, ustime()-start);
+
+    printf("bytes per value: list %lu, ulist %.2f (checksum %ld)\n",
+           (unsigned long)sizeof(list_node_t),
+           (double)(ulist_node_count(ulist)*sizeof(ulist_node_t) +
+                    sizeof(ulist_t))/len, sum);
+    list_free(list);
+    ulist_free(ulist);
+}
+
+/* Random positional lookups on a list of 'len' values. */
+static void bench_index(const char *name, list_t *list, long len, long ops)
+{
+    long long start;
+    unsigned long seed = 1;
+    long i, sum = 0;
+
+    for (i = 0; i < len; i++)
+        list_add(list, (void*)i);
+    start = ustime();
+    for (i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        sum += (long)list_value(list_index(list, (seed >> 33) % len));
+    }
+    report(name, ops, ustime()-start);
+    if (sum < 0) printf("unreachable\n");
+}
+
+/* Load 'len' values 'rounds' times, one by one or in batches. */
+static void bench_load(long len, long rounds, long batch)
+{
+    void **values = malloc(sizeof(void*)*batch);
+    list_t *list;
+    long long start;
+    long i, j, r;
+
+    for (i = 0; i < batch; i++) values[i] = (void*)i;
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        list = list_create();
+        for (i = 0; i < len; i++)
+            list_add(list, (void*)i);
+        list_free(list);
+    }
+    report("load list_add", len*rounds, ustime()-start);
+
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        list = list_create();
+        for (i = 0; i < len; i += j) {
+            j = len-i < batch ? len-i : batch;
+            list_add_bulk(list, values, j);
+        }
+        list_free(list);
+    }
+    report("load list_add_bulk", len*rounds, ustime()-start);
+
+    start = ustime();
+    for (r = 0; r < rounds; r++) {
+        list = list_create_pooled(NULL);
+        for (i = 0; i < len; i += j) {
+            j = len-i < batch ? len-i : batch;
+            list_add_bulk(list, values, j);
+        }
+        list_free(list);
+    }
+    report("load list_add_bulk pooled", len*rounds, ustime()-start);
+    free(values);
+}
+
+static int cmp_long(void *a, void *b)
+{
+    return (long)a < (long)b ? -1 : (long)a > (long)b;
+}
+
+static int qsort_cmp_long(const void *a, const void *b)
+{
+    return cmp_long(*(void**)a, *(void**)b);
+}
+
+/* Pooled, so every run starts from nodes laid out in list order rather
+ * than from whatever the previous run left in the malloc free lists. */
+static list_t *random_list(long len)
+{
+    list_t *list = list_create_pooled(NULL);
+    unsigned long seed = 1;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        list_add(list, (void*)(long)(seed >> 33));
+    }
+    return list;
+}
+
+/* Sorting 'len' random values: copy to an array, qsort() and rebuild,
+ * against list_sort() and list_sort_parallel(). */
+static void bench_sort(long len, int threads)
+{
+    list_t *list, *sorted;
+    list_node_t *node;
+    void **values;
+    long long start;
+    long i;
+
+    list = random_list(len);
+    start = ustime();
+    values = malloc(sizeof(void*)*len);
+    i = 0;
+    list_foreach(list, node) values[i++] = list_value(node);
+    qsort(values, len, sizeof(void*), qsort_cmp_long);
+    sorted = list_create();
+    for (i = 0; i < len; i++) list_add(sorted, values[i]);
+    report("sort array+qsort+rebuild", len, ustime()-start);
+    free(values);
+    list_free(sorted);
+    list_free(list);
+
+    list = random_list(len);
+    start = ustime();
+    list_sort(list, cmp_long);
+    report("sort list_sort", len, ustime()-start);
+    list_free(list);
+
+    list = random_list(len);
+    start = ustime();
+    list_sort_parallel(list, cmp_long, threads);
+    report("sort list_sort_parallel", len, ustime()-start);
+    list_free(list);
+}
+
+/* Snapshot a list of 'len' values and read the snapshot once. */
+static void bench_clone(long len, int cow)
+{
+    list_t *list = list_create(), *snap;
+    list_node_t *node;
+    long long start;
+    long i, sum = 0;
+
+    for (i = 0; i < len; i++) list_add(list, (void*)i);
+    start = ustime();
+    snap = cow ? list_clone_cow(list) : list_clone(list);
+    list_foreach(snap, node) sum += (long)list_value(node);
+    report(cow ? "clone+read list_clone_cow" : "clone+read list_clone",
+           len, ustime()-start);
+    list_free(snap);
+    list_free(list);
+    if (sum < 0) printf("unreachable\n");
+}
+
+int main(int argc, char **argv)
+{
+    long batch = argc > 1 ? atol(argv[1]) : 1000000;
+    long rounds = argc > 2 ? atol(argv[2]) : 10;
+    list_t *list;
+
+    list = list_create();
+    bench_push_pop("push/pop malloc", list, batch, rounds);
+    list_free(list);
+
+    list = list_create_pooled(NULL);
+    bench_push_pop("push/pop pooled", list, batch, rounds);
+    list_free(list);
+
+    bench_scan(batch, rounds);
+    bench_load(batch, rounds, 4096);
+    bench_clone(batch, 0);
+    bench_clone(batch, 1);
+    bench_sort(batch, argc > 3 ? atoi(argv[3]) : 4);
+
+    list = list_create();
+    bench_index("list_index plain", list, batch, 100);
+    list_free(list);
+    list = list_create_indexed();
+    bench_index("list_index indexed", list, batch, 1000000);
+    list_free(list);
+    return 0;
+}
@@ -1,9 +1,560 @@
 #include "list.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+
+#include "testhelp.h"
+
+/* Check that the links, the length and the values 0..len-1 stored as
+ * integers agree with each other in both directions. */
+static int list_check_sequence(list_t *list, long len)
+{
+    list_node_t *node;
+    long i;
+
+    if ((long)list_size(list) != len) return 0;
+    for (i = 0, node = list_first(list); node; node = node->next, i++)
+        if ((long)list_value(node) != i) return 0;
+    if (i != len) return 0;
+    for (i = len-1, node = list_last(list); node; node = list_prev(node), i--)
+        if ((long)list_value(node) != i) return 0;
+    return i == -1;
+}
+
+static void test_basic(list_t *list)
+{
+    list_node_t *node;
+    long i;
+
+    for (i = 1; i < 100; i++)
+        test_cond("list_add", list_add(list, (void*)i) == list);
+    test_cond("list_add_head", list_add_head(list, (void*)0) == list);
+    test_cond("sequence after add", list_check_sequence(list, 100));
+    test_cond("list_index head", list_value(list_index(list, 0)) == (void*)0);
+    test_cond("list_index tail", list_value(list_index(list, -1)) == (void*)99);
+    test_cond("list_index range", list_index(list, 100) == NULL);
+
+    node = list_search(list, (void*)50);
+    test_cond("list_search", node && list_value(node) == (void*)50);
+    list_remove(list, node);
+    test_cond("list_remove", list_size(list) == 99 &&
+              list_search(list, (void*)50) == NULL);
+    node = list_index(list, 49);
+    test_cond("list_insert", list_insert(list, node, (void*)50, 1) == list);
+    test_cond("sequence after insert", list_check_sequence(list, 100));
+
+    list_rotate(list);
+    test_cond("list_rotate", list_value(list_first(list)) == (void*)99);
+    node = list_first(list);
+    list_remove(list, node);
+    test_cond("list_add after rotate", list_add(list, (void*)99) == list);
+    test_cond("sequence after rotate", list_check_sequence(list, 100));
+}
+
+/* Check the treap of an indexed list: parent links, subtree sizes, heap
+ * ordered priorities, and an in-order walk matching the list links. */
+static int tree_check(list_inode_t *n, list_inode_t *parent,
+                      list_node_t **expect)
+{
+    if (n == NULL) return 1;
+    if (n->parent != parent) return 0;
+    if (parent && parent->priority < n->priority) return 0;
+    if (n->size != 1 + (n->left ? n->left->size : 0) +
+                       (n->right ? n->right->size : 0)) return 0;
+    if (!tree_check(n->left, n, expect)) return 0;
+    if (*expect != &n->node) return 0;
+    *expect = (*expect)->next;
+    return tree_check(n->right, n, expect);
+}
+
+static int list_check_tree(list_t *list)
+{
+    list_node_t *expect = list_first(list);
+
+    return tree_check(list->tree->root, NULL, &expect) && expect == NULL &&
+           (list->tree->root ? list->tree->root->size : 0) == list_size(list);
+}
+
+static void test_indexed(void)
+{
+    list_t *list;
+    list_node_t *node;
+    long i, j, errors;
+
+    test_cond("indexed list", (list = list_create_indexed()) != NULL);
+    test_basic(list);
+    test_cond("tree after basic ops", list_check_tree(list));
+    list_free(list);
+
+    /* Build 0..999 by inserting at pseudo random positions, then check
+     * positions from both ends and ranks, then remove half of it. */
+    list = list_create_indexed();
+    list_add(list, (void*)0);
+    for (i = 1; i < 1000; i++) {
+        j = (i * 7919 + 13) % i;
+        node = list_index(list, j);
+        list_insert(list, node, (void*)i, 0);
+    }
+    test_cond("tree after inserts", list_check_tree(list));
+    errors = 0;
+    for (i = 0, node = list_first(list); node; node = node->next, i++) {
+        if (list_index(list, i) != node) errors++;
+        if (list_index(list, i - (long)list_size(list)) != node) errors++;
+        if (list_rank(list, node) != (unsigned long)i) errors++;
+    }
+    test_cond("list_index/list_rank agree", errors == 0);
+    for (i = 0; i < 500; i++)
+        list_remove(list, list_index(list, (i * 31) % list_size(list)));
+    test_cond("tree after removals", list_size(list) == 500 &&
+              list_check_tree(list));
+    for (i = 0; i < 10; i++) list_rotate(list);
+    test_cond("tree after rotate", list_check_tree(list));
+    list_free(list);
+}
+
+static void test_bulk(void)
+{
+    void *values[300];
+    list_pool_t *pool;
+    list_t *list, *other;
+    long i;
+
+    for (i = 0; i < 300; i++) values[i] = (void*)i;
+
+    /* Plain lists keep allocating one node at a time, empty or not, so
+     * they still exchange nodes with other plain lists. */
+    list = list_create();
+    test_cond("bulk on empty list", list_add_bulk(list, values+100, 100) &&
+              list->pool == NULL);
+    test_cond("bulk head", list_add_head_bulk(list, values, 100) == list);
+    test_cond("bulk tail", list_add_bulk(list, values+200, 100) == list);
+    test_cond("bulk sequence", list_check_sequence(list, 300));
+    other = list_create();
+    list_add(other, (void*)300);
+    test_cond("bulk then join", list_join(list, other) == list &&
+              list_size(other) == 0 && list_value(list_last(list)) ==
+              (void*)300);
+    list_remove(list, list_last(list));
+    list_add(other, (void*)300);
+    test_cond("bulk then join into plain list",
+              list_join(other, list) == other && list_size(other) == 301 &&
+              list_value(list_first(other)) == (void*)300);
+    list_free(list);
+    list_free(other);
+
+    /* Batches smaller and bigger than a slab, spilling over slabs. */
+    pool = list_pool_create(16);
+    list = list_create_pooled(pool);
+    list_pool_release(pool);
+    list_add(list, (void*)0);
+    list_add_bulk(list, values+1, 9);
+    list_add_bulk(list, values+10, 10);
+    list_add_bulk(list, values+20, 100);
+    list_add_bulk(list, values+120, 180);
+    test_cond("bulk across slabs", list_check_sequence(list, 300));
+    list_free(list);
+
+    list = list_create_indexed();
+    list_add_bulk(list, values+100, 200);
+    list_add_head_bulk(list, values, 100);
+    test_cond("bulk on indexed list", list_check_sequence(list, 300) &&
+              list_check_tree(list) && list_value(list_index(list, 150)) ==
+              (void*)150);
+    list_free(list);
+}
+
+/* Build a list holding the integers from..to-1. */
+static list_t *list_range(list_t *list, long from, long to)
+{
+    long i;
+
+    for (i = from; i < to; i++) list_add(list, (void*)i);
+    return list;
+}
+
+static void test_relink_kind(list_t *(*create)(void), int indexed)
+{
+    list_t *a, *b, *rest;
+    list_node_t *first, *last, *node;
+
+    /* list_join */
+    a = list_range(create(), 0, 50);
+    b = list_range(create(), 50, 100);
+    test_cond("list_join", list_join(a, b) == a && list_size(b) == 0 &&
+              b->head == NULL && list_check_sequence(a, 100));
+    test_cond("list_join empty", list_join(a, b) == a &&
+              list_check_sequence(a, 100));
+    test_cond("list_join into empty", list_join(b, a) == b &&
+              list_check_sequence(b, 100) && list_size(a) == 0);
+    if (indexed) {
+        test_cond("list_join tree", list_check_tree(b) && list_check_tree(a));
+    }
+    list_free(a);
+
+    /* list_split_at near the tail, near the head, and at the head. */
+    rest = list_split_at(b, list_index(b, 90));
+    test_cond("list_split_at tail", rest && list_size(b) == 90 &&
+              list_size(rest) == 10 && list_value(list_first(rest)) ==
+              (void*)90 && list_last(b)->next == NULL);
+    list_join(b, rest);
+    list_free(rest);
+    rest = list_split_at(b, list_index(b, 3));
+    test_cond("list_split_at head", list_size(b) == 3 &&
+              list_size(rest) == 97 && list_prev(list_first(rest)) == NULL);
+    list_join(b, rest);
+    list_free(rest);
+    test_cond("list_split_at rejoined", list_check_sequence(b, 100));
+    rest = list_split_at(b, list_first(b));
+    test_cond("list_split_at first", list_size(b) == 0 && b->head == NULL &&
+              list_check_sequence(rest, 100));
+    if (indexed) {
+        test_cond("list_split_at tree", list_check_tree(b) &&
+                  list_check_tree(rest));
+    }
+    list_free(b);
+
+    /* list_splice: move 10..19 at the head of a list holding 0..9, then
+     * move 20..29 after 19, then put the remainder after 29. */
+    a = list_range(create(), 0, 10);
+    b = rest;
+    while ((node = list_first(b)) && list_value(node) < (void*)10)
+        list_remove(b, node);
+    first = list_index(b, 0);
+    last = list_index(b, 9);
+    test_cond("list_splice head", list_splice(a, NULL, b, first, last, 0) == a &&
+              list_size(a) == 20 && list_size(b) == 80 &&
+              list_value(list_first(a)) == (void*)10);
+    rest = list_split_at(a, list_index(a, 10));
+    list_join(rest, a);
+    list_join(a, rest);
+    list_free(rest);
+    test_cond("list_splice moved", list_check_sequence(a, 20));
+    first = list_index(b, 0);
+    last = list_index(b, 9);
+    list_splice(a, list_last(a), b, first, last, 10);
+    test_cond("list_splice tail", list_check_sequence(a, 30));
+    list_splice(a, list_last(a), b, list_first(b), list_last(b),
+                list_size(b));
+    test_cond("list_splice all", list_check_sequence(a, 100) &&
+              list_size(b) == 0 && b->head == NULL && b->tail == NULL);
+    if (indexed) {
+        test_cond("list_splice tree", list_check_tree(a) &&
+                  list_check_tree(b));
+    }
+    list_free(a);
+    list_free(b);
+}
+
+static list_t *list_create_private(void)
+{
+    return list_create_pooled(NULL);
+}
+
+static void test_relink(void)
+{
+    list_t *a, *b;
+
+    test_relink_kind(list_create, 0);
+    test_relink_kind(list_create_indexed, 1);
+
+    a = list_range(list_create_private(), 0, 10);
+    b = list_range(list_create_private(), 10, 20);
+    test_cond("list_join pool mismatch", list_join(a, b) == NULL &&
+              list_size(a) == 10 && list_size(b) == 10);
+    list_free(a);
+    a = list_create();
+    test_cond("list_join adopts pool", list_join(a, b) == a &&
+              a->pool == b->pool && list_size(a) == 10);
+    list_free(b);
+    list_free(a);
+}
+
+/* Values are (key << 20 | sequence) so that stability can be checked. */
+static int sort_cmp(void *a, void *b)
+{
+    long ka = (long)a >> 20, kb = (long)b >> 20;
+
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int list_check_sorted(list_t *list, long len)
+{
+    list_node_t *node, *prev = NULL;
+    long count = 0;
+
+    list_foreach(list, node) {
+        if (node->prev != prev) return 0;
+        if (prev && (long)list_value(prev) > (long)list_value(node)) return 0;
+        prev = node;
+        count++;
+    }
+    return prev == list_last(list) && count == len &&
+           (long)list_size(list) == len;
+}
+
+static void test_sort_kind(list_t *list, long len, int threads)
+{
+    unsigned long seed = 12345;
+    long i;
+
+    for (i = 0; i < len; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        list_add(list, (void*)((long)((seed >> 40) % 1000) << 20 | i));
+    }
+    if (threads)
+        list_sort_parallel(list, sort_cmp, threads);
+    else
+        list_sort(list, sort_cmp);
+    test_cond("list sorted and stable", list_check_sorted(list, len));
+    if (list->tree) {
+        test_cond("tree after sort", list_check_tree(list) &&
+                  list_index(list, len/2) == list_index(list, len/2 - len));
+    }
+    list_free(list);
+}
+
+static void test_sort(void)
+{
+    test_sort_kind(list_create(), 0, 0);
+    test_sort_kind(list_create(), 1, 0);
+    test_sort_kind(list_create(), 1000, 0);
+    test_sort_kind(list_create(), 1001, 4);
+    test_sort_kind(list_create_pooled(NULL), 100000, 0);
+    test_sort_kind(list_create(), 100000, 3);
+    test_sort_kind(list_create(), 100000, 8);
+    /* Enough nodes for more than LIST_SORT_MAX_THREADS chunks. */
+    test_sort_kind(list_create(), 300000, -1);
+    test_sort_kind(list_create_indexed(), 5000, 0);
+    test_sort_kind(list_create_indexed(), 50000, 4);
+}
+
+static long live_values = 0;
+
+static void *counted_dup(void *ptr)
+{
+    long *copy = malloc(sizeof(long));
+
+    *copy = *(long*)ptr;
+    live_values++;
+    return copy;
+}
+
+static void counted_free(void *ptr)
+{
+    free(ptr);
+    live_values--;
+}
+
+static void test_clone_cow_kind(list_t *orig, int indexed)
+{
+    list_t *snap, *snap2, *snap3;
+    list_node_t *node, *next;
+    long i;
+
+    list_range(orig, 0, 100);
+    snap = list_clone_cow(orig);
+    test_cond("cow clone shares nodes", snap && list_first(snap) ==
+              list_first(orig) && list_check_sequence(snap, 100));
+    test_cond("cow clone index", list_index(snap, 42) == list_index(orig, 42));
+
+    /* Mutating the original leaves the snapshot alone: the original
+     * keeps its nodes and the snapshot gets a copy. */
+    node = list_index(orig, 10);
+    next = list_index(orig, 11);
+    list_remove(orig, node);
+    test_cond("cow original mutated", list_size(orig) == 99 &&
+              list_index(orig, 10) == next && orig->share == NULL);
+    test_cond("cow snapshot intact", list_check_sequence(snap, 100) &&
+              list_index(snap, 11) != next);
+    list_insert(orig, list_index(orig, 9), (void*)10, 1);
+    test_cond("cow original private", list_check_sequence(orig, 100) &&
+              list_first(orig) != list_first(snap));
+
+    /* Three lists sharing nodes: the two left alone keep sharing the
+     * copy. */
+    snap2 = list_clone_cow(snap);
+    snap3 = list_clone_cow(snap2);
+    node = list_search(snap2, (void*)50);
+    list_remove(snap2, node);
+    test_cond("cow clone of clone", list_size(snap2) == 99 &&
+              list_search(snap2, (void*)50) == NULL &&
+              list_check_sequence(snap, 100) &&
+              list_first(snap) == list_first(snap3) &&
+              list_first(snap) != list_first(snap2));
+    list_free(snap3);
+    list_add(snap2, (void*)100);
+    /* Everybody else went private: 'snap' owns its nodes alone. */
+    node = list_last(snap);
+    list_rotate(snap);
+    test_cond("cow last sharer owns", list_first(snap) == node &&
+              snap->share == NULL);
+    if (indexed) {
+        test_cond("cow trees", list_check_tree(orig) && list_check_tree(snap)
+                  && list_check_tree(snap2));
+    }
+    list_free(snap2);
+    list_free(snap);
+
+    /* Removing nodes while walking a list that has a clone. */
+    snap = list_clone_cow(orig);
+    list_foreach_safe(orig, node, next)
+        if ((long)list_value(node) & 1) list_remove(orig, node);
+    i = 0;
+    list_foreach(orig, node)
+        if ((long)list_value(node) != 2*i++) break;
+    test_cond("cow foreach_safe remove", node == NULL && i == 50 &&
+              list_size(orig) == 50 && list_check_sequence(snap, 100));
+    list_free(snap);
+    snap = list_clone_cow(orig);
+    list_foreach_safe(snap, node, next) list_remove(snap, node);
+    test_cond("cow foreach_safe remove all", list_size(snap) == 0 &&
+              list_first(snap) == NULL && list_size(orig) == 50 &&
+              list_value(list_last(orig)) == (void*)98);
+    if (indexed)
+        test_cond("cow trees after walk", list_check_tree(orig));
+    list_free(orig);
+    list_free(snap);
+}
+
+static void test_clone_cow(void)
+{
+    list_t *orig, *snap;
+    long *value;
+    long i;
+
+    test_clone_cow_kind(list_create(), 0);
+    test_clone_cow_kind(list_create_pooled(NULL), 0);
+    test_clone_cow_kind(list_create_indexed(), 1);
+
+    /* Values are duplicated only when a sharer mutates, and freed once. */
+    orig = list_create();
+    list_set_clone_method(orig, counted_dup);
+    list_set_free_method(orig, counted_free);
+    for (i = 0; i < 10; i++) {
+        value = malloc(sizeof(long));
+        *value = i;
+        live_values++;
+        list_add(orig, value);
+    }
+    snap = list_clone_cow(orig);
+    test_cond("cow clone no dup", live_values == 10);
+    list_free(snap);
+    snap = list_clone_cow(orig);
+    list_add_head(snap, counted_dup(list_value(list_first(orig))));
+    test_cond("cow dup on write", live_values == 21 && list_size(snap) == 11);
+    list_free(orig);
+    list_free(snap);
+    test_cond("cow values freed", live_values == 0);
+
+    /* Splicing between two lists sharing their nodes. */
+    orig = list_range(list_create(), 0, 10);
+    snap = list_clone_cow(orig);
+    test_cond("cow splice", list_splice(snap, list_index(snap, 4), orig,
+              list_first(orig), list_index(orig, 1), 2) == snap &&
+              list_size(orig) == 8 && list_size(snap) == 12 &&
+              list_value(list_index(snap, 5)) == (void*)0 &&
+              list_value(list_index(snap, 7)) == (void*)5);
+    list_free(orig);
+    list_free(snap);
+}
+
+/* A background thread frees snapshots while the main thread keeps
+ * changing the original. */
+static void *free_snapshot(void *arg)
+{
+    list_free(arg);
+    return NULL;
+}
+
+static void test_clone_cow_thread(void)
+{
+    list_t *list = list_range(list_create(), 0, 1000);
+    list_t *snap;
+    pthread_t tid;
+    long i;
+
+    for (i = 0; i < 200; i++) {
+        snap = list_clone_cow(list);
+        pthread_create(&tid, NULL, free_snapshot, snap);
+        list_remove(list, list_first(list));
+        list_add(list, (void*)(1000+i));
+        pthread_join(tid, NULL);
+    }
+    test_cond("cow snapshots freed by a thread", list_size(list) == 1000 &&
+              list->share == NULL &&
+              list_value(list_first(list)) == (void*)200);
+    list_free(list);
+}
+
+static void test_foreach(void)
+{
+    list_t *list = list_create();
+    list_node_t *node, *next;
+    long i, sum;
+
+    for (i = 0; i < 10; i++) list_add(list, (void*)i);
+    sum = 0;
+    list_foreach(list, node) sum += (long)list_value(node);
+    test_cond("list_foreach", sum == 45);
+    i = 9;
+    list_foreach_reverse(list, node)
+        if ((long)list_value(node) != i--) break;
+    test_cond("list_foreach_reverse", node == NULL && i == -1);
+    list_foreach_safe(list, node, next)
+        if ((long)list_value(node) & 1) list_remove(list, node);
+    sum = 0;
+    list_foreach(list, node) sum += (long)list_value(node);
+    test_cond("list_foreach_safe", list_size(list) == 5 && sum == 20);
+    list_free(list);
+}
+
+static void test_pool(void)
+{
+    list_pool_t *pool;
+    list_t *a, *b, *copy;
+    long i;
+
+    test_cond("private pool", (a = list_create_pooled(NULL)) != NULL);
+    test_basic(a);
+    list_free(a);
+
+    /* Two lists sharing a tiny pool, so that several slabs are needed
+     * and nodes freed by one list get recycled by the other. */
+    pool = list_pool_create(7);
+    a = list_create_pooled(pool);
+    b = list_create_pooled(pool);
+    list_pool_release(pool);
+    for (i = 0; i < 50; i++) list_add(a, (void*)i);
+    while (list_size(a)) list_remove(a, list_first(a));
+    test_cond("pool recycles nodes", pool->free_nodes != NULL);
+    for (i = 0; i < 100; i++) list_add(b, (void*)i);
+    test_cond("shared pool sequence", list_check_sequence(b, 100));
+    copy = list_clone(b);
+    test_cond("pooled clone", copy && copy->pool == pool &&
+              list_check_sequence(copy, 100));
+    list_free(a);
+    list_free(b);
+    test_cond("pool still referenced", pool->refs == 1);
+    list_free(copy);
+}
 
 int main(int argc, char **argv)
 {
-    printf("hello\n");
-    return 0;
+    list_t *list;
+
+    (void)argc;
+    (void)argv;
+    list = list_create();
+    test_basic(list);
+    list_free(list);
+    test_foreach();
+    test_pool();
+    test_indexed();
+    test_bulk();
+    test_relink();
+    test_sort();
+    test_clone_cow();
+    test_clone_cow_thread();
+
+    test_report();
 }
@@ -0,0 +1,118 @@
+#include "list.h"
+#include "queue.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, int threads, long ops, long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-20s %3d+%-3d threads %10ld ops %8lld us %12.0f ops/sec\n",
+           name, threads, threads, ops, us, (double)ops*1000000/us);
+}
+
+/* Every producer pushes 'items' values, every consumer pops as many. */
+static long items;
+static queue_t *queue;
+static list_t *list;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *queue_producer(void *arg)
+{
+    long i;
+
+    (void)arg;
+    for (i = 1; i <= items; i++)
+        while (queue_add(queue, (void*)i) == NULL) sched_yield();
+    return NULL;
+}
+
+static void *queue_consumer(void *arg)
+{
+    long got = 0;
+
+    (void)arg;
+    while (got < items) {
+        if (queue_pop(queue))
+            got++;
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *list_producer(void *arg)
+{
+    long i;
+
+    (void)arg;
+    for (i = 1; i <= items; i++) {
+        pthread_mutex_lock(&lock);
+        list_add(list, (void*)i);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void *list_consumer(void *arg)
+{
+    list_node_t *node;
+    long got = 0;
+
+    (void)arg;
+    while (got < items) {
+        pthread_mutex_lock(&lock);
+        if ((node = list_first(list)) != NULL) {
+            list_remove(list, node);
+            got++;
+        }
+        pthread_mutex_unlock(&lock);
+        if (node == NULL) sched_yield();
+    }
+    return NULL;
+}
+
+static void run(const char *name, int threads,
+                void *(*producer)(void*), void *(*consumer)(void*))
+{
+    pthread_t *tids = malloc(sizeof(pthread_t)*threads*2);
+    long long start;
+    int j;
+
+    start = ustime();
+    for (j = 0; j < threads; j++) {
+        pthread_create(&tids[j*2], NULL, consumer, NULL);
+        pthread_create(&tids[j*2+1], NULL, producer, NULL);
+    }
+    for (j = 0; j < threads*2; j++)
+        pthread_join(tids[j], NULL);
+    report(name, threads, items*threads*2, ustime()-start);
+    free(tids);
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    int threads;
+
+    items = argc > 2 ? atol(argv[2]) : 1000000;
+    queue = queue_create(65536);
+    list = list_create();
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        run("mutex+list_t", threads, list_producer, list_consumer);
+        run("queue_t", threads, queue_producer, queue_consumer);
+    }
+    list_free(list);
+    queue_free(queue);
+    return 0;
+}
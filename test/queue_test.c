@@ -0,0 +1,99 @@
+#include "queue.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "testhelp.h"
+
+static void test_single_thread(void)
+{
+    queue_t *queue = queue_create(100);
+    long i;
+
+    test_cond("capacity rounded", queue_capacity(queue) == 128);
+    test_cond("capacity too large", queue_create((unsigned long)-1) == NULL &&
+              queue_create((unsigned long)-1/2+1) == NULL);
+    test_cond("empty pop", queue_pop(queue) == NULL);
+    test_cond("NULL rejected", queue_add(queue, NULL) == NULL);
+    for (i = 1; i <= 128; i++)
+        if (queue_add(queue, (void*)i) != queue) break;
+    test_cond("fill", i == 129 && queue_size(queue) == 128);
+    test_cond("full", queue_add(queue, (void*)129) == NULL);
+    /* Wrap around the ring a few times keeping FIFO order. */
+    for (i = 1; i <= 1000; i++) {
+        if (queue_pop(queue) != (void*)i) break;
+        if (queue_add(queue, (void*)(i+128)) != queue) break;
+    }
+    test_cond("fifo across laps", i == 1001);
+    for (i = 1001; i <= 1128; i++)
+        if (queue_pop(queue) != (void*)i) break;
+    test_cond("drain", i == 1129 && queue_size(queue) == 0 &&
+              queue_pop(queue) == NULL);
+    queue_free(queue);
+}
+
+#define MT_THREADS 4
+#define MT_ITEMS 100000
+
+static queue_t *mt_queue;
+static long mt_sums[MT_THREADS];
+static long mt_counts[MT_THREADS];
+
+static void *producer(void *arg)
+{
+    long id = (long)arg, i;
+
+    for (i = 1; i <= MT_ITEMS; i++) {
+        while (queue_add(mt_queue, (void*)(id*MT_ITEMS + i)) == NULL)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    long id = (long)arg;
+    void *value;
+
+    while (mt_counts[id] < MT_ITEMS) {
+        if ((value = queue_pop(mt_queue)) == NULL) {
+            sched_yield();
+            continue;
+        }
+        mt_sums[id] += (long)value;
+        mt_counts[id]++;
+    }
+    return NULL;
+}
+
+static void test_multi_thread(void)
+{
+    pthread_t producers[MT_THREADS], consumers[MT_THREADS];
+    long i, sum = 0, expect = 0;
+
+    mt_queue = queue_create(1024);
+    for (i = 0; i < MT_THREADS; i++) {
+        pthread_create(&consumers[i], NULL, consumer, (void*)i);
+        pthread_create(&producers[i], NULL, producer, (void*)i);
+    }
+    for (i = 0; i < MT_THREADS; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+        sum += mt_sums[i];
+        expect += i*MT_ITEMS*MT_ITEMS + (long)MT_ITEMS*(MT_ITEMS+1)/2;
+    }
+    test_cond("every value consumed once", sum == expect &&
+              queue_pop(mt_queue) == NULL);
+    queue_free(mt_queue);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    test_single_thread();
+    test_multi_thread();
+
+    test_report();
+}
@@ -0,0 +1,184 @@
+#include "hash.h"
+#include "shardmap.h"
+#include "rcuhash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, const char *mix, int threads, long ops,
+                   long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-12s %-12s %3d threads %10ld ops %8lld us %12.0f ops/sec\n",
+           name, mix, threads, ops, us, (double)ops*1000000/us);
+}
+
+#define KEY_SIZE 16
+
+/* The read path of rcuhash_t against shardmap_t and a Hash behind one
+ * mutex. 'len' keys, half of them in the map at the start. Every thread
+ * runs 'ops' operations on random keys, of which 'writes' per thousand
+ * insert or delete a key and the others look one up. rcuhash_t readers
+ * go through a quiescent state every QUIESCENT_OPS operations. */
+#define QUIESCENT_OPS 64
+
+static char *keys;
+static long len;
+static long ops;
+static int writes;
+
+static Hash hash;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static shardmap_t *map;
+static rcuhash_t *rcu;
+
+static unsigned long rnd(unsigned long *seed)
+{
+    *seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+    return *seed >> 33;
+}
+
+static void *hash_worker(void *arg)
+{
+    unsigned long seed = (unsigned long)arg + 1, r;
+    long i;
+
+    for (i = 0; i < ops; i++) {
+        char *key;
+
+        r = rnd(&seed);
+        key = keys + r % len * KEY_SIZE;
+        pthread_mutex_lock(&lock);
+        if ((long)(r >> 20) % 1000 < writes)
+            sqlite3HashInsert(&hash, key, r & 1 ? key : NULL);
+        else
+            sqlite3HashFind(&hash, key);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void *shardmap_worker(void *arg)
+{
+    unsigned long seed = (unsigned long)arg + 1, r;
+    long i;
+
+    for (i = 0; i < ops; i++) {
+        char *key;
+
+        r = rnd(&seed);
+        key = keys + r % len * KEY_SIZE;
+        if ((long)(r >> 20) % 1000 < writes)
+            shardmap_insert(map, key, r & 1 ? key : NULL);
+        else
+            shardmap_find(map, key);
+    }
+    return NULL;
+}
+
+static void *rcuhash_worker(void *arg)
+{
+    unsigned long seed = (unsigned long)arg + 1, r;
+    rcuhash_reader_t *reader = rcuhash_register(rcu);
+    long i;
+
+    for (i = 0; i < ops; i++) {
+        char *key;
+
+        r = rnd(&seed);
+        key = keys + r % len * KEY_SIZE;
+        if ((long)(r >> 20) % 1000 < writes)
+            rcuhash_insert(rcu, key, r & 1 ? key : NULL);
+        else
+            rcuhash_find(rcu, key);
+        if (i % QUIESCENT_OPS == 0) rcuhash_quiescent(reader);
+    }
+    rcuhash_unregister(rcu, reader);
+    return NULL;
+}
+
+static void run(const char *name, const char *mix, int threads,
+                void *(*worker)(void*))
+{
+    pthread_t *tids = malloc(sizeof(pthread_t)*threads);
+    long long start;
+    long j;
+
+    start = ustime();
+    for (j = 0; j < threads; j++)
+        pthread_create(&tids[j], NULL, worker, (void*)j);
+    for (j = 0; j < threads; j++)
+        pthread_join(tids[j], NULL);
+    report(name, mix, threads, ops*threads, ustime()-start);
+    free(tids);
+}
+
+/* Delete every key while a registered reader never goes through a
+ * quiescent state, so nothing can be reclaimed: the writer must not slow
+ * down as the backlog grows. */
+static void bench_stalled(void)
+{
+    rcuhash_t *stalled = rcuhash_create();
+    rcuhash_reader_t *reader;
+    long long start;
+    long i;
+
+    for (i = 0; i < len; i++)
+        rcuhash_insert(stalled, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+    reader = rcuhash_register(stalled);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        rcuhash_insert(stalled, keys+i*KEY_SIZE, NULL);
+    report("rcuhash", "stalled", 1, len, ustime()-start);
+    rcuhash_unregister(stalled, reader);
+    rcuhash_synchronize(stalled);
+    rcuhash_free(stalled);
+}
+
+/* Usage: rcuhash_bench [max threads] [keys] [ops per thread] */
+int main(int argc, char **argv)
+{
+    static const struct { const char *name; int writes; } mixes[] = {
+        { "read-only", 0 }, { "99% reads", 10 }
+    };
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    int threads, m;
+    long i;
+
+    len = argc > 2 ? atol(argv[2]) : 1000000;
+    ops = argc > 3 ? atol(argv[3]) : 1000000;
+    keys = malloc((size_t)len*KEY_SIZE);
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*KEY_SIZE, "key:%ld", i);
+    sqlite3HashInit(&hash);
+    map = shardmap_create(256);
+    rcu = rcuhash_create();
+    for (i = 0; i < len; i += 2) {
+        sqlite3HashInsert(&hash, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+        shardmap_insert(map, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+        rcuhash_insert(rcu, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+    }
+    for (m = 0; m < 2; m++) {
+        writes = mixes[m].writes;
+        for (threads = 1; threads <= max_threads; threads *= 2) {
+            run("mutex+Hash", mixes[m].name, threads, hash_worker);
+            run("shardmap", mixes[m].name, threads, shardmap_worker);
+            run("rcuhash", mixes[m].name, threads, rcuhash_worker);
+        }
+    }
+    bench_stalled();
+    sqlite3HashClear(&hash);
+    shardmap_free(map);
+    rcuhash_free(rcu);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "rcuhash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define TESTHELP_KEYS
+#include "testhelp.h"
+
+static void test_single_thread(void)
+{
+    rcuhash_t *map = rcuhash_create();
+    rcuhash_reader_t *reader = rcuhash_register(map);
+    int i;
+
+    test_cond("empty find", rcuhash_find(map, "missing") == NULL &&
+              rcuhash_size(map) == 0);
+    for (i = 0; i < N_KEYS; i++)
+        if (rcuhash_insert(map, keys[i], keys[i]) != NULL) break;
+    test_cond("insert", i == N_KEYS && rcuhash_size(map) == N_KEYS);
+    for (i = 0; i < N_KEYS; i++)
+        if (rcuhash_find(map, keys[i]) != keys[i]) break;
+    test_cond("find", i == N_KEYS);
+    test_cond("case insensitive", rcuhash_find(map, "KEY:42") == keys[42]);
+    test_cond("replace", rcuhash_insert(map, "KEY:7", keys[8]) == keys[7] &&
+              rcuhash_find(map, "key:7") == keys[8]);
+    for (i = 0; i < N_KEYS; i += 2) {
+        if (rcuhash_insert(map, keys[i], NULL) == NULL) break;
+        rcuhash_quiescent(reader);
+    }
+    test_cond("delete", i >= N_KEYS && rcuhash_size(map) == N_KEYS/2 &&
+              rcuhash_find(map, keys[2]) == NULL &&
+              rcuhash_find(map, keys[3]) == keys[3]);
+    test_cond("delete missing", rcuhash_insert(map, keys[2], NULL) == NULL);
+    rcuhash_unregister(map, reader);
+    rcuhash_synchronize(map);
+    rcuhash_free(map);
+}
+
+/* A reader that never goes through a quiescent state holds back every
+ * removed element, until it does. */
+static void test_stalled_reader(void)
+{
+    rcuhash_t *map = rcuhash_create();
+    rcuhash_reader_t *stalled = rcuhash_register(map);
+    int round, i;
+
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < N_KEYS; i++) rcuhash_insert(map, keys[i], keys[i]);
+        for (i = 0; i < N_KEYS; i += 2) rcuhash_insert(map, keys[i], NULL);
+        for (i = 0; i < N_KEYS; i++)
+            if (rcuhash_find(map, keys[i]) != (i % 2 ? keys[i] : NULL))
+                break;
+        test_cond("stalled reader", i == N_KEYS &&
+                  rcuhash_size(map) == N_KEYS/2);
+        if (round == 1) rcuhash_quiescent(stalled);
+    }
+    rcuhash_unregister(map, stalled);
+    rcuhash_synchronize(map);
+    rcuhash_free(map);
+}
+
+/* Readers look up every key in a loop, while a writer inserts and
+ * deletes the odd keys and grows the map: the even keys must always be
+ * found, and the odd ones either found or not, never with other data. */
+#define MT_READERS 3
+
+static rcuhash_t *mt_map;
+static atomic_int mt_done;
+static int mt_errors[MT_READERS];
+static long mt_lookups[MT_READERS];
+
+static void *reader_thread(void *arg)
+{
+    long id = (long)arg;
+    rcuhash_reader_t *reader = rcuhash_register(mt_map);
+    int i;
+
+    while (!atomic_load(&mt_done)) {
+        for (i = 0; i < N_KEYS; i++) {
+            void *data = rcuhash_find(mt_map, keys[i]);
+            if (i % 2 == 0 ? data != keys[i] : data != NULL && data != keys[i])
+                mt_errors[id]++;
+            if (i % 64 == 0) rcuhash_quiescent(reader);
+        }
+        mt_lookups[id] += N_KEYS;
+    }
+    rcuhash_unregister(mt_map, reader);
+    return NULL;
+}
+
+static void test_multi_thread(void)
+{
+    pthread_t readers[MT_READERS];
+    long i;
+    int round, errors = 0;
+
+    mt_map = rcuhash_create();
+    for (i = 0; i < N_KEYS; i += 2) rcuhash_insert(mt_map, keys[i], keys[i]);
+    for (i = 0; i < MT_READERS; i++)
+        pthread_create(&readers[i], NULL, reader_thread, (void*)i);
+    for (round = 0; round < 20; round++) {
+        for (i = 1; i < N_KEYS; i += 2)
+            rcuhash_insert(mt_map, keys[i], round % 2 ? NULL : keys[i]);
+    }
+    atomic_store(&mt_done, 1);
+    for (i = 0; i < MT_READERS; i++) {
+        pthread_join(readers[i], NULL);
+        errors += mt_errors[i];
+    }
+    test_cond("lookups during writes", errors == 0);
+    for (i = 0; i < N_KEYS; i++)
+        if (rcuhash_find(mt_map, keys[i]) != (i % 2 ? NULL : keys[i])) break;
+    test_cond("contents", i == N_KEYS && rcuhash_size(mt_map) == N_KEYS/2);
+    rcuhash_synchronize(mt_map);
+    rcuhash_free(mt_map);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    make_keys();
+    test_single_thread();
+    test_stalled_reader();
+    test_multi_thread();
+
+    test_report();
+}
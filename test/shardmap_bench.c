@@ -0,0 +1,130 @@
+#include "hash.h"
+#include "shardmap.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, const char *mix, int threads, long ops,
+                   long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-12s %-12s %3d threads %10ld ops %8lld us %12.0f ops/sec\n",
+           name, mix, threads, ops, us, (double)ops*1000000/us);
+}
+
+#define KEY_SIZE 16
+
+/* 'len' keys, half of them in the map at the start. Every thread runs
+ * 'ops' operations on random keys, of which 'writes' percent insert or
+ * delete a key and the others look one up. */
+static char *keys;
+static long len;
+static long ops;
+static int writes;
+
+static Hash hash;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static shardmap_t *map;
+
+static unsigned long rnd(unsigned long *seed)
+{
+    *seed = *seed * 6364136223846793005UL + 1442695040888963407UL;
+    return *seed >> 33;
+}
+
+static void *hash_worker(void *arg)
+{
+    unsigned long seed = (unsigned long)arg + 1, r;
+    long i;
+
+    for (i = 0; i < ops; i++) {
+        char *key;
+
+        r = rnd(&seed);
+        key = keys + r % len * KEY_SIZE;
+        pthread_mutex_lock(&lock);
+        if ((long)(r >> 20) % 100 < writes)
+            sqlite3HashInsert(&hash, key, r & 1 ? key : NULL);
+        else
+            sqlite3HashFind(&hash, key);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void *shardmap_worker(void *arg)
+{
+    unsigned long seed = (unsigned long)arg + 1, r;
+    long i;
+
+    for (i = 0; i < ops; i++) {
+        char *key;
+
+        r = rnd(&seed);
+        key = keys + r % len * KEY_SIZE;
+        if ((long)(r >> 20) % 100 < writes)
+            shardmap_insert(map, key, r & 1 ? key : NULL);
+        else
+            shardmap_find(map, key);
+    }
+    return NULL;
+}
+
+static void run(const char *name, const char *mix, int threads,
+                void *(*worker)(void*))
+{
+    pthread_t *tids = malloc(sizeof(pthread_t)*threads);
+    long long start;
+    long j;
+
+    start = ustime();
+    for (j = 0; j < threads; j++)
+        pthread_create(&tids[j], NULL, worker, (void*)j);
+    for (j = 0; j < threads; j++)
+        pthread_join(tids[j], NULL);
+    report(name, mix, threads, ops*threads, ustime()-start);
+    free(tids);
+}
+
+/* Usage: shardmap_bench [max threads] [keys] [ops per thread] */
+int main(int argc, char **argv)
+{
+    static const struct { const char *name; int writes; } mixes[] = {
+        { "read-heavy", 1 }, { "write-heavy", 50 }
+    };
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    int threads, m;
+    long i;
+
+    len = argc > 2 ? atol(argv[2]) : 1000000;
+    ops = argc > 3 ? atol(argv[3]) : 1000000;
+    keys = malloc((size_t)len*KEY_SIZE);
+    for (i = 0; i < len; i++)
+        sprintf(keys+i*KEY_SIZE, "key:%ld", i);
+    sqlite3HashInit(&hash);
+    map = shardmap_create(256);
+    for (i = 0; i < len; i += 2) {
+        sqlite3HashInsert(&hash, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+        shardmap_insert(map, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+    }
+    for (m = 0; m < 2; m++) {
+        writes = mixes[m].writes;
+        for (threads = 1; threads <= max_threads; threads *= 2) {
+            run("mutex+Hash", mixes[m].name, threads, hash_worker);
+            run("shardmap", mixes[m].name, threads, shardmap_worker);
+        }
+    }
+    sqlite3HashClear(&hash);
+    shardmap_free(map);
+    free(keys);
+    return 0;
+}
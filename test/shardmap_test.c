@@ -0,0 +1,90 @@
+#include "shardmap.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define TESTHELP_KEYS
+#include "testhelp.h"
+
+static void test_single_thread(void)
+{
+    shardmap_t *map = shardmap_create(5);
+    int i;
+
+    test_cond("empty find", shardmap_find(map, "missing") == NULL &&
+              shardmap_size(map) == 0);
+    test_cond("too many shards", shardmap_create((unsigned int)-1) == NULL);
+    for (i = 0; i < N_KEYS; i++)
+        if (shardmap_insert(map, keys[i], keys[i]) != NULL) break;
+    test_cond("insert", i == N_KEYS && shardmap_size(map) == N_KEYS);
+    for (i = 0; i < N_KEYS; i++)
+        if (shardmap_find(map, keys[i]) != keys[i]) break;
+    test_cond("find", i == N_KEYS);
+    test_cond("case insensitive", shardmap_find(map, "KEY:42") == keys[42]);
+    test_cond("replace", shardmap_insert(map, "KEY:7", keys[8]) == keys[7] &&
+              shardmap_find(map, "key:7") == keys[8]);
+    for (i = 0; i < N_KEYS; i += 2)
+        if (shardmap_insert(map, keys[i], NULL) == NULL) break;
+    test_cond("delete", i >= N_KEYS && shardmap_size(map) == N_KEYS/2 &&
+              shardmap_find(map, keys[2]) == NULL &&
+              shardmap_find(map, keys[3]) == keys[3]);
+    shardmap_free(map);
+}
+
+/* Every thread owns the keys equal to its id modulo MT_THREADS: it
+ * inserts them, deletes every other one and reinserts them, while
+ * looking up the keys of the other threads. */
+#define MT_THREADS 4
+
+static shardmap_t *mt_map;
+static int mt_errors[MT_THREADS];
+
+static void *worker(void *arg)
+{
+    long id = (long)arg;
+    int i, round;
+
+    for (round = 0; round < 3; round++) {
+        for (i = (int)id; i < N_KEYS; i += MT_THREADS) {
+            void *old = shardmap_insert(mt_map, keys[i],
+                                        round == 1 && i % 2 ? NULL : keys[i]);
+            if (old != (round == 0 || (round == 2 && i % 2) ? NULL : keys[i]))
+                mt_errors[id]++;
+            old = shardmap_find(mt_map, keys[(i+1) % N_KEYS]);
+            if (old != NULL && old != keys[(i+1) % N_KEYS])
+                mt_errors[id]++;
+        }
+    }
+    return NULL;
+}
+
+static void test_multi_thread(void)
+{
+    pthread_t threads[MT_THREADS];
+    long i;
+    int errors = 0;
+
+    mt_map = shardmap_create(16);
+    for (i = 0; i < MT_THREADS; i++)
+        pthread_create(&threads[i], NULL, worker, (void*)i);
+    for (i = 0; i < MT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += mt_errors[i];
+    }
+    test_cond("concurrent inserts and deletes", errors == 0);
+    for (i = 0; i < N_KEYS; i++)
+        if (shardmap_find(mt_map, keys[i]) != keys[i]) break;
+    test_cond("contents", i == N_KEYS && shardmap_size(mt_map) == N_KEYS);
+    shardmap_free(mt_map);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    make_keys();
+    test_single_thread();
+    test_multi_thread();
+
+    test_report();
+}
@@ -0,0 +1,132 @@
+#include "hash.h"
+#include "swiss.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static long long ustime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static void report(const char *name, long len, long ops, long long us)
+{
+    if (us <= 0) us = 1;
+    printf("%-18s %10ld keys %10ld ops %8lld us %12.0f ops/sec\n",
+           name, len, ops, us, (double)ops*1000000/us);
+}
+
+#define KEY_SIZE 24
+
+/* 'len' keys in one buffer, and the order of random lookups: 'ops'
+ * indexes below 'len', a miss being a key of the same shape that is not
+ * in the table. */
+static char *keys;
+static char *misses;
+static long *order;
+
+static void make_keys(long len, long ops)
+{
+    unsigned long seed = 1;
+    long i;
+
+    keys = malloc((size_t)len*KEY_SIZE);
+    misses = malloc((size_t)len*KEY_SIZE);
+    order = malloc(sizeof(long)*ops);
+    for (i = 0; i < len; i++) {
+        sprintf(keys+i*KEY_SIZE, "key:%ld", i);
+        sprintf(misses+i*KEY_SIZE, "key:%ld", len+i);
+    }
+    for (i = 0; i < ops; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        order[i] = (long)((seed >> 16) % len);
+    }
+}
+
+static void free_keys(void)
+{
+    free(keys);
+    free(misses);
+    free(order);
+}
+
+static void bench_hash(long len, long ops)
+{
+    long long start;
+    long i, found = 0;
+    Hash h;
+
+    sqlite3HashInit(&h);
+    start = ustime();
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+    report("Hash insert", len, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += sqlite3HashFind(&h, keys+order[i]*KEY_SIZE) != NULL;
+    report("Hash find hit", len, ops, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += sqlite3HashFind(&h, misses+order[i]*KEY_SIZE) != NULL;
+    report("Hash find miss", len, ops, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        sqlite3HashInsert(&h, keys+i*KEY_SIZE, NULL);
+    report("Hash delete", len, len, ustime()-start);
+    if (found != ops) printf("unexpected: %ld keys found\n", found);
+    sqlite3HashClear(&h);
+}
+
+static void bench_swiss(long len, long ops)
+{
+    swiss_t *map = swiss_create();
+    long long start;
+    long i, found = 0;
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        swiss_insert(map, keys+i*KEY_SIZE, keys+i*KEY_SIZE);
+    report("swiss insert", len, len, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += swiss_find(map, keys+order[i]*KEY_SIZE) != NULL;
+    report("swiss find hit", len, ops, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < ops; i++)
+        found += swiss_find(map, misses+order[i]*KEY_SIZE) != NULL;
+    report("swiss find miss", len, ops, ustime()-start);
+
+    start = ustime();
+    for (i = 0; i < len; i++)
+        swiss_delete(map, keys+i*KEY_SIZE);
+    report("swiss delete", len, len, ustime()-start);
+    if (found != ops) printf("unexpected: %ld keys found\n", found);
+    swiss_free(map);
+}
+
+/* Every argument is a table size to run, 1K and 1M by default; pass
+ * 50000000 for the 50M run, which needs several GB of memory. */
+int main(int argc, char **argv)
+{
+    static const long sizes[] = { 1000, 1000000 };
+    long len, ops;
+    int j, n = argc > 1 ? argc-1 : 2;
+
+    for (j = 0; j < n; j++) {
+        len = argc > 1 ? atol(argv[j+1]) : sizes[j];
+        ops = len < 1000000 ? 1000000 : len;
+        make_keys(len, ops);
+        bench_hash(len, ops);
+        bench_swiss(len, ops);
+        free_keys();
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "swiss.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TESTHELP_KEYS
+#include "testhelp.h"
+
+/* Check that keys[i] maps to itself exactly when present[i] is set, by
+ * lookups and by iterating the map. */
+static int swiss_check(swiss_t *map, const char *present)
+{
+    swiss_iter_t iter;
+    swiss_slot_t *slot;
+    size_t n = 0, expect = 0;
+    int i;
+
+    for (i = 0; i < N_KEYS; i++) {
+        if (swiss_find(map, keys[i]) != (present[i] ? keys[i] : NULL))
+            return 0;
+        expect += present[i] != 0;
+    }
+    swiss_foreach(map, iter, slot) {
+        if (slot->data != slot->key) return 0;
+        n++;
+    }
+    return n == expect && swiss_size(map) == n;
+}
+
+static void test_basic(void)
+{
+    swiss_t *map = swiss_create();
+    static char present[N_KEYS];
+    int i;
+
+    test_cond("empty find", swiss_find(map, "missing") == NULL &&
+              swiss_delete(map, "missing") == NULL);
+    for (i = 0; i < N_KEYS; i++) {
+        if (swiss_insert(map, keys[i], keys[i]) != NULL) break;
+        present[i] = 1;
+    }
+    test_cond("insert", i == N_KEYS && swiss_check(map, present));
+    test_cond("case insensitive", swiss_find(map, "KEY:42") == keys[42]);
+    test_cond("replace", swiss_insert(map, "KEY:7", keys[8]) == keys[7] &&
+              swiss_find(map, "key:7") == keys[8]);
+    swiss_insert(map, keys[7], keys[7]);
+    for (i = 0; i < N_KEYS; i += 2) {
+        if (swiss_delete(map, keys[i]) != keys[i]) break;
+        present[i] = 0;
+    }
+    test_cond("delete", i >= N_KEYS && swiss_check(map, present));
+    test_cond("delete missing", swiss_delete(map, keys[0]) == NULL);
+    for (i = 1; i < N_KEYS; i += 4) {
+        if (swiss_insert(map, keys[i], NULL) != keys[i]) break;
+        present[i] = 0;
+    }
+    test_cond("insert NULL deletes", i >= N_KEYS && swiss_check(map, present));
+    for (i = 0; i < N_KEYS; i += 2) {
+        swiss_insert(map, keys[i], keys[i]);
+        present[i] = 1;
+    }
+    test_cond("reinsert", swiss_check(map, present));
+    swiss_clear(map);
+    memset(present, 0, sizeof(present));
+    test_cond("clear", swiss_check(map, present));
+    swiss_insert(map, keys[3], keys[3]);
+    present[3] = 1;
+    test_cond("insert after clear", swiss_check(map, present));
+    swiss_free(map);
+}
+
+/* Keep the map at a steady size while churning through many more keys
+ * than it holds, so deleted slots have to be reclaimed. */
+static void test_churn(void)
+{
+    swiss_t *map = swiss_create();
+    static char present[N_KEYS];
+    int i, ok = 1;
+
+    for (i = 0; i < N_KEYS; i++) {
+        swiss_insert(map, keys[i], keys[i]);
+        present[i] = 1;
+        if (i >= 100) {
+            swiss_delete(map, keys[i-100]);
+            present[i-100] = 0;
+        }
+        if (i % 1000 == 999) ok = ok && swiss_check(map, present);
+    }
+    test_cond("churn", ok && swiss_size(map) == 100);
+    swiss_free(map);
+}
+
+static void test_delete_iterating(void)
+{
+    swiss_t *map = swiss_create();
+    swiss_iter_t iter;
+    swiss_slot_t *slot;
+    int i, seen = 0;
+
+    for (i = 0; i < N_KEYS; i++) swiss_insert(map, keys[i], keys[i]);
+    swiss_foreach(map, iter, slot) {
+        swiss_delete(map, slot->key);
+        seen++;
+    }
+    test_cond("delete while iterating", seen == N_KEYS &&
+              swiss_size(map) == 0 && swiss_find(map, keys[1]) == NULL);
+    swiss_free(map);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    make_keys();
+    test_basic();
+    test_churn();
+    test_delete_iterating();
+
+    test_report();
+}
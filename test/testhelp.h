@@ -0,0 +1,47 @@
+/* testhelp.h - A really minimal testing framework for C
+ *
+ * In the spirit of the one of redis: test_cond() checks a condition and
+ * reports it with its location if it does not hold, and test_report()
+ * ends main() with a summary and the exit status ctest looks at.
+ *
+ * A test defining TESTHELP_KEYS before including this file also gets
+ * keys[], N_KEYS strings "key:0", "key:1"... filled by make_keys().
+ */
+
+#ifndef __TESTHELP_H__
+#define __TESTHELP_H__
+
+#include <stdio.h>
+
+static int failed = 0;
+
+#define test_cond(descr, _c) do { \
+    if (!(_c)) { \
+        printf("FAILED: %s (%s:%d)\n", descr, __FILE__, __LINE__); \
+        failed++; \
+    } \
+} while(0)
+
+#define test_report() do { \
+    if (failed) { \
+        printf("%d test(s) failed\n", failed); \
+        return 1; \
+    } \
+    printf("all tests passed\n"); \
+    return 0; \
+} while(0)
+
+#ifdef TESTHELP_KEYS
+#define N_KEYS 10000
+
+static char keys[N_KEYS][16];
+
+static void make_keys(void)
+{
+    int i;
+
+    for (i = 0; i < N_KEYS; i++) sprintf(keys[i], "key:%d", i);
+}
+#endif
+
+#endif /* __TESTHELP_H__ */
@@ -0,0 +1,98 @@
+#include "ulist.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "testhelp.h"
+
+/* Check that the list holds the integers 0..len-1 in order, walking it
+ * with iterators in both directions. */
+static int ulist_check_sequence(ulist_t *list, long len)
+{
+    ulist_iter_t iter;
+    void **slot;
+    long i;
+
+    if ((long)ulist_size(list) != len) return 0;
+    ulist_rewind(list, &iter);
+    for (i = 0; (slot = ulist_next(&iter)) != NULL; i++)
+        if ((long)*slot != i) return 0;
+    if (i != len) return 0;
+    ulist_rewind_tail(list, &iter);
+    for (i = len-1; (slot = ulist_next(&iter)) != NULL; i--)
+        if ((long)*slot != i) return 0;
+    return i == -1;
+}
+
+static void test_add_index(void)
+{
+    ulist_t *list = ulist_create();
+    ulist_iter_t iter;
+    void **slot;
+    long i;
+
+    for (i = 500; i < 1000; i++) ulist_add(list, (void*)i);
+    for (i = 499; i >= 0; i--) ulist_add_head(list, (void*)i);
+    test_cond("sequence after add", ulist_check_sequence(list, 1000));
+    test_cond("nodes are packed",
+              ulist_node_count(list) <= 1000/ULIST_NODE_FILL+2);
+    for (i = 0; i < 1000; i++) {
+        if (*ulist_index(list, i) != (void*)i ||
+            *ulist_index(list, -1-i) != (void*)(999-i)) break;
+    }
+    test_cond("ulist_index", i == 1000);
+    test_cond("ulist_index range", ulist_index(list, 1000) == NULL &&
+              ulist_index(list, -1001) == NULL);
+    test_cond("ulist_search", *ulist_search(list, (void*)777) == (void*)777);
+    i = 0;
+    ulist_foreach(list, iter, slot)
+        if (*slot != (void*)i++) break;
+    test_cond("ulist_foreach", slot == NULL && i == 1000);
+    ulist_free(list);
+}
+
+static void test_remove(void)
+{
+    ulist_t *list = ulist_create();
+    ulist_iter_t iter;
+    void **slot;
+    void *value;
+    long i, expect;
+
+    for (i = 0; i < 1000; i++) ulist_add(list, (void*)i);
+    /* Drop every odd value walking forward, then every value that is a
+     * multiple of four walking backward. */
+    ulist_rewind(list, &iter);
+    while ((slot = ulist_next(&iter)) != NULL)
+        if ((long)*slot & 1) ulist_remove(list, &iter);
+    ulist_rewind_tail(list, &iter);
+    while ((slot = ulist_next(&iter)) != NULL)
+        if ((long)*slot % 4 == 0) ulist_remove(list, &iter);
+    test_cond("remove length", ulist_size(list) == 250);
+    ulist_rewind(list, &iter);
+    expect = 2;
+    while ((slot = ulist_next(&iter)) != NULL) {
+        if ((long)*slot != expect) break;
+        expect += 4;
+    }
+    test_cond("remove contents", slot == NULL && expect == 1002);
+
+    test_cond("pop head", ulist_pop(list, ULIST_HEAD, &value) &&
+              value == (void*)2);
+    test_cond("pop tail", ulist_pop(list, ULIST_TAIL, &value) &&
+              value == (void*)998);
+    while (ulist_pop(list, ULIST_HEAD, &value));
+    test_cond("pop empties the list", ulist_size(list) == 0 &&
+              ulist_node_count(list) == 0 && list->head == NULL &&
+              list->tail == NULL);
+    ulist_free(list);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    test_add_index();
+    test_remove();
+
+    test_report();
+}